@@ -109,6 +109,17 @@ uint8_t UserTxBufferFS[APP_TX_DATA_SIZE];
 extern USBD_HandleTypeDef hUsbDeviceFS;
 
 /* USER CODE BEGIN EXPORTED_VARIABLES */
+/**
+  * @brief  CDC_IsTransmitting_FS
+  *         Check whether the buffer passed to CDC_Transmit_FS is still in use.
+  *
+  * @retval 1 until the IN transfer completes, else 0
+  */
+uint8_t CDC_IsTransmitting_FS(void)
+{
+  USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef*)hUsbDeviceFS.pClassData;
+  return (hcdc != NULL && hcdc->TxState != 0) ? 1 : 0;
+}
 
 /* USER CODE END EXPORTED_VARIABLES */
 
@@ -286,6 +297,9 @@ uint8_t CDC_Transmit_FS(uint8_t* Buf, uint16_t Len)
   uint8_t result = USBD_OK;
   /* USER CODE BEGIN 7 */
   USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef*)hUsbDeviceFS.pClassData;
+  if (hcdc == NULL){
+    return USBD_FAIL;
+  }
   if (hcdc->TxState != 0){
     return USBD_BUSY;
   }
@@ -8,83 +8,148 @@
 #include "message/msgdef.h"
 #include "peripheral/encoder.h"
 #include <algorithm>
+#include <iterator>
 
-mik::Application::Application()        //
-    : motor0_(PWM_TIM,                 //
-              LL_TIM_OC_SetCompareCH1, //
-              {INA1_Pin,               //
-               INA1_GPIO_Port},        //
-              {INA2_Pin,               //
-               INA2_GPIO_Port},        //
-              {MOTOR1_LED_Pin,         //
-               MOTOR1_LED_GPIO_Port}), //
-      motor1_(PWM_TIM,                 //
-              LL_TIM_OC_SetCompareCH2, //
-              {INB1_Pin,               //
-               INB1_GPIO_Port},        //
-              {INB2_Pin,               //
-               INB2_GPIO_Port},        //
-              {MOTOR2_LED_Pin,         //
-               MOTOR2_LED_GPIO_Port})  //
+namespace
+{
+/// モータID順のモータドライバとLEDの接続
+mik::MotorPort const MOTOR_PORTS[] = {
+    {PWM_TIM, LL_TIM_CHANNEL_CH1, LL_TIM_OC_SetCompareCH1, {INA1_Pin, INA1_GPIO_Port}, {INA2_Pin, INA2_GPIO_Port}, {MOTOR1_LED_Pin, MOTOR1_LED_GPIO_Port}}, //
+    {PWM_TIM, LL_TIM_CHANNEL_CH2, LL_TIM_OC_SetCompareCH2, {INB1_Pin, INB1_GPIO_Port}, {INB2_Pin, INB2_GPIO_Port}, {MOTOR2_LED_Pin, MOTOR2_LED_GPIO_Port}}, //
+};
+static_assert(sizeof(MOTOR_PORTS) / sizeof(MOTOR_PORTS[0]) == MOTOR_COUNT, "MOTOR_PORTS must have MOTOR_COUNT entries");
+/// モータ状態を通知する周期（Hz）
+constexpr uint32_t STATUS_RATE_HZ = 10;
+static_assert(CONTROL_TICK_HZ % STATUS_RATE_HZ == 0, "CONTROL_TICK_HZ must be a multiple of STATUS_RATE_HZ");
+} // namespace
+
+mik::Application::Application() //
+    : bank_(MOTOR_PORTS),        //
+      statusTick_(0),            //
+      epoch_()                   //
 {
   initEncoder();
-  LL_TIM_CC_EnableChannel(PWM_TIM, LL_TIM_CHANNEL_CH1);
-  LL_TIM_CC_EnableChannel(PWM_TIM, LL_TIM_CHANNEL_CH2);
-  LL_TIM_EnableCounter(PWM_TIM);
-  LL_TIM_EnableAllOutputs(PWM_TIM);
+}
+void mik::Application::publishStatus() const
+{
+  for (uint32_t i = 0; i < MOTOR_COUNT; ++i)
+  {
+    Motor const &m = motor(i);
+    msg::MotorStatus s{};
+    s.motor = i;
+    s.mode = static_cast<uint8_t>(m.mode());
+    s.tuner = static_cast<uint8_t>(m.tuner().state());
+    s.running = m.isRunning() ? 1 : 0;
+    s.ultimateGain = m.tuner().ultimateGain();
+    s.ultimatePeriod = m.tuner().ultimatePeriod();
+    s.current = m.getCurrent();
+    s.busVoltage = m.getBusVoltage();
+    s.encoder = m.encoder();
+    s.velocity = m.getVelocity();
+    s.nob = m.nob();
+    msg::publish<msg::MOTOR_STATUS_NOTIFY>(s);
+  }
+}
+void mik::Application::resetPosition(uint32_t i)
+{
+  epoch_[i] = resetEncoder(1 << i, 1 << i);
+  bank_.resetPosition(i);
 }
 void mik::Application::control()
 {
-  motor0_.control();
-  motor1_.control();
+  bank_.control();
+  if (CONTROL_TICK_HZ / STATUS_RATE_HZ <= ++statusTick_)
+  {
+    statusTick_ = 0;
+    publishStatus();
+  }
 }
 void mik::Application::update(msg::Message const *msg)
 {
-  switch (msg->type)
+  using Handlers = msg::Dispatcher<Application,                //
+                                   msg::KEY_MOTOR_LEFT,        //
+                                   msg::KEY_MOTOR_RIGHT,       //
+                                   msg::KEY_USR_BTN,           //
+                                   msg::ENCODER_DATA_NOTIFY,   //
+                                   msg::CURRENT_DATA_NOTIFY,   //
+                                   msg::MOTOR_GAINS_REQ,       //
+                                   msg::MOTOR_FEEDFORWARD_REQ, //
+                                   msg::MOTOR_GEAR_REQ,        //
+                                   msg::MOTOR_SYNC_MOVE_REQ,   //
+                                   msg::MOTOR_COORD_STOP_REQ>;
+  Handlers::dispatch(*this, msg);
+}
+void mik::Application::on(msg::Tag<msg::KEY_MOTOR_LEFT>, msg::KeyData const &k)
+{
+  if (k.motor < MOTOR_COUNT)
   {
-  case msg::KEY_MOTOR1_LEFT:
-    motor(0).changeRunningMode();
-    resetEncoder(1 | 4);
-    break;
-  case msg::KEY_MOTOR1_RIGHT:
-    motor(0).changeControlMode();
-    resetEncoder(1 | 4);
-    break;
-  case msg::KEY_MOTOR2_LEFT:
-    motor(1).changeRunningMode();
-    resetEncoder(2 | 8);
-    break;
-  case msg::KEY_MOTOR2_RIGHT:
-    motor(1).changeControlMode();
-    resetEncoder(2 | 8);
-    break;
-  case msg::KEY_USR_BTN:
-    LL_GPIO_TogglePin(LED_GPIO_Port, LED_Pin);
-    break;
-  case msg::ENCODER_DATA_NOTIFY:
+    resetPosition(k.motor);
+    motor(k.motor).changeRunningMode();
+  }
+}
+void mik::Application::on(msg::Tag<msg::KEY_MOTOR_RIGHT>, msg::KeyData const &k)
+{
+  if (k.motor < MOTOR_COUNT)
   {
-    auto enc = msg->get<msg::EncoderData>();
-    for (uint32_t i = 0; i < MOTOR_COUNT; ++i)
-    {
-      auto &m = motor(i);
-      m.encoder().set(enc.motor[i]);
-      m.nob().set(enc.rotary[i]);
-      m.setVelocity(enc.motorVelocity[i]);
-    }
-    control(); // 制御周期を一定にするためここで呼ぶ。（ここだと100Hz）
-    break;
+    resetPosition(k.motor);
+    motor(k.motor).changeControlMode();
   }
-  case msg::CURRENT_DATA_NOTIFY:
+}
+void mik::Application::on(msg::Tag<msg::KEY_USR_BTN>)
+{
+  LL_GPIO_TogglePin(LED_GPIO_Port, LED_Pin);
+}
+void mik::Application::on(msg::Tag<msg::ENCODER_DATA_NOTIFY>, msg::EncoderData const &enc)
+{
+  auto &sig = bank_.signals();
+  for (uint32_t i = 0; i < MOTOR_COUNT; ++i)
   {
-    auto c = msg->get<msg::CurrentData>();
-    for (uint32_t i = 0; i < MOTOR_COUNT; ++i)
+    if (static_cast<int16_t>(enc.epoch[i] - epoch_[i]) < 0)
     {
-      auto &m = motor(i);
-      m.setCurrent(c.current[i]);
-      m.setBusVoltage(c.busVoltage[i]);
-      m.setShuntVoltage(c.shuntVoltage[i]);
+      continue; // リセット前にラッチした値なので、resetPosition で0にした値を保つ
     }
-    break;
+    sig.encoder[i] = enc.motor[i];
+    sig.nob[i] = enc.rotary[i];
+    sig.velocity[i] = enc.motorVelocity[i];
+    sig.speed[i] = enc.motorSpeed[i];
   }
+  bank_.record(enc.stamp);
+  if (CONTROL_RATE_HZ == 0)
+  {
+    control(); // タイマ同期制御でなければ、制御周期を一定にするためここで呼ぶ。（ここだと100Hz）
+  }
+}
+void mik::Application::on(msg::Tag<msg::CURRENT_DATA_NOTIFY>, msg::CurrentData const &c)
+{
+  auto &sig = bank_.signals();
+  std::copy(std::begin(c.current), std::end(c.current), sig.current);
+  std::copy(std::begin(c.busVoltage), std::end(c.busVoltage), sig.busVoltage);
+  std::copy(std::begin(c.shuntVoltage), std::end(c.shuntVoltage), sig.shuntVoltage);
+  std::fill(std::begin(sig.freshCurrent), std::end(sig.freshCurrent), true);
+}
+void mik::Application::on(msg::Tag<msg::MOTOR_GAINS_REQ>, msg::MotorGainsReq const &req)
+{
+  if (req.motor < MOTOR_COUNT)
+  {
+    motor(req.motor).setGains(req.gains);
   }
 }
+void mik::Application::on(msg::Tag<msg::MOTOR_FEEDFORWARD_REQ>, msg::MotorFeedforwardReq const &req)
+{
+  if (req.motor < MOTOR_COUNT)
+  {
+    motor(req.motor).setFeedforward(req.ff);
+  }
+}
+void mik::Application::on(msg::Tag<msg::MOTOR_GEAR_REQ>, msg::MotorGearReq const &req)
+{
+  bank_.coordinator().gear(req.master, req.follower, req.ratio, req.offset);
+}
+void mik::Application::on(msg::Tag<msg::MOTOR_SYNC_MOVE_REQ>, msg::MotorSyncMoveReq const &req)
+{
+  bank_.coordinator().move(req.axes, req.target);
+}
+void mik::Application::on(msg::Tag<msg::MOTOR_COORD_STOP_REQ>)
+{
+  bank_.coordinator().stop();
+}
@@ -6,8 +6,8 @@
 
 #pragma once
 
-#include "control/motor.h"
-#include "message/msglib.h"
+#include "control/motor_bank.h"
+#include "message/msgdef.h"
 
 namespace mik
 {
@@ -22,8 +22,16 @@ class mik::Application
   Application &operator=(Application const &) = delete;
   Application &operator=(Application &&) = delete;
 
-  Motor motor0_;
-  Motor motor1_;
+  MotorBank bank_;              ///< 全モータ
+  uint32_t statusTick_;         ///< 前回モータ状態を通知してからの制御回数
+  uint16_t epoch_[MOTOR_COUNT]; ///< モータIDごとに待っているエンコーダ値のリセットの番号
+
+  /// @brief 全モータの状態を購読者（表示、USB）へ通知する
+  void publishStatus() const;
+  /// @brief モータとノブのエンコーダ値を0に戻す
+  /// @param [in] i モータID
+  /// @note 制御が古い位置から軌道を引き直さないように、次のサンプルを待たずにモータ側の値も0にする
+  void resetPosition(uint32_t i);
 
 public:
   /// @brief コンストラクタ
@@ -31,15 +39,44 @@ public:
   /// @brief デストラクタ
   virtual ~Application() {}
   /// @brief モータを取得する
-  /// @param [in] i モータID(0 or 1)
+  /// @param [in] i モータID
   /// @return モータ
-  Motor &motor(uint32_t i) { return i ? motor1_ : motor0_; }
+  Motor &motor(uint32_t i) { return bank_.motor(i); }
   /// @brief モータを取得する
-  /// @param [in] i モータID(0 or 1)
+  /// @param [in] i モータID
   /// @return モータ
-  Motor const &motor(uint32_t i) const { return const_cast<Application *>(this)->motor(i); }
+  Motor const &motor(uint32_t i) const { return bank_.motor(i); }
   /// @brief モータ制御する
+  /// @note STATUS_RATE_HZ ごとに MOTOR_STATUS_NOTIFY を配信する
   void control();
   /// @brief RTOSメッセージを元に状態を更新する
   void update(msg::Message const *msg);
+  /// @brief モータ左キー押下
+  /// @param [in] k キーデータ
+  void on(msg::Tag<msg::KEY_MOTOR_LEFT>, msg::KeyData const &k);
+  /// @brief モータ右キー押下
+  /// @param [in] k キーデータ
+  void on(msg::Tag<msg::KEY_MOTOR_RIGHT>, msg::KeyData const &k);
+  /// @brief ユーザボタン押下
+  void on(msg::Tag<msg::KEY_USR_BTN>);
+  /// @brief エンコーダデータ通知
+  /// @param [in] enc エンコーダデータ
+  void on(msg::Tag<msg::ENCODER_DATA_NOTIFY>, msg::EncoderData const &enc);
+  /// @brief 電流値通知
+  /// @param [in] c 電流値
+  void on(msg::Tag<msg::CURRENT_DATA_NOTIFY>, msg::CurrentData const &c);
+  /// @brief モータ制御ゲイン変更要求
+  /// @param [in] req 変更要求
+  void on(msg::Tag<msg::MOTOR_GAINS_REQ>, msg::MotorGainsReq const &req);
+  /// @brief モータ制御フィードフォワード係数変更要求
+  /// @param [in] req 変更要求
+  void on(msg::Tag<msg::MOTOR_FEEDFORWARD_REQ>, msg::MotorFeedforwardReq const &req);
+  /// @brief 電子ギア開始要求
+  /// @param [in] req 開始要求
+  void on(msg::Tag<msg::MOTOR_GEAR_REQ>, msg::MotorGearReq const &req);
+  /// @brief 同期移動開始要求
+  /// @param [in] req 開始要求
+  void on(msg::Tag<msg::MOTOR_SYNC_MOVE_REQ>, msg::MotorSyncMoveReq const &req);
+  /// @brief 連動停止要求
+  void on(msg::Tag<msg::MOTOR_COORD_STOP_REQ>);
 };
\ No newline at end of file
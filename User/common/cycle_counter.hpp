@@ -0,0 +1,40 @@
+/// @file      common/cycle_counter.hpp
+/// @author    Hiroshi Mikuriya
+/// @copyright Copyright© 2022 Hiroshi Mikuriya
+///
+/// DO NOT USE THIS SOFTWARE WITHOUT THE SOFTWARE LICENSE AGREEMENT.
+
+#pragma once
+
+#include "main.h"
+
+namespace mik
+{
+class CycleCounter;
+}
+
+/// @brief DWTのサイクルカウンタで時刻を計測するクラス
+/// @note 168MHz で約25秒ごとに一周するので、差分は必ず符号なし32bitで計算すること。
+class mik::CycleCounter
+{
+  CycleCounter() = delete; ///< インスタンス化禁止
+
+public:
+  /// @brief サイクルカウンタを開始する（開始済みなら何もしない）
+  static void enable() noexcept
+  {
+    if ((DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk) == 0)
+    {
+      CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+      DWT->CYCCNT = 0;
+      DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    }
+  }
+  /// @brief 現在のサイクル数を取得する
+  /// @return サイクル数
+  static uint32_t now() noexcept { return DWT->CYCCNT; }
+  /// @brief サイクル数をマイクロ秒に変換する
+  /// @param [in] cycles サイクル数
+  /// @return マイクロ秒
+  static uint32_t toMicros(uint32_t cycles) noexcept { return cycles / (SystemCoreClock / 1000000); }
+};
@@ -0,0 +1,39 @@
+/// @file      common/interrupt_lock.hpp
+/// @author    Hiroshi Mikuriya
+/// @copyright Copyright© 2022 Hiroshi Mikuriya
+///
+/// DO NOT USE THIS SOFTWARE WITHOUT THE SOFTWARE LICENSE AGREEMENT.
+
+#pragma once
+
+#include "main.h"
+
+namespace mik
+{
+class InterruptLock;
+}
+
+/// @brief 全割り込みを禁止して排他するクラス
+/// @note 割り込みとタスクの間で共有する短い処理の排他に使う。
+///       LockGuard から使えるように、関数の分け方を std::mutex に合わせている。
+class mik::InterruptLock
+{
+  InterruptLock(InterruptLock const &) = delete;            ///< コピーコンストラクタ削除
+  InterruptLock &operator=(InterruptLock const &) = delete; ///< 代入演算子削除
+
+  uint32_t primask_; ///< ロック前の割り込み禁止状態
+
+public:
+  /// @brief コンストラクタ
+  InterruptLock() noexcept : primask_(0) {}
+  /// @brief デストラクタ
+  virtual ~InterruptLock() {}
+  /// @brief 割り込みを禁止する
+  void lock() noexcept
+  {
+    primask_ = __get_PRIMASK();
+    __disable_irq();
+  }
+  /// @brief 割り込み禁止状態をロック前に戻す
+  void unlock() noexcept { __set_PRIMASK(primask_); }
+};
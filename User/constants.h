@@ -4,3 +4,26 @@
 
 /// モータ数
 constexpr uint32_t MOTOR_COUNT = 2;
+#ifndef CONTROL_RATE
+#define CONTROL_RATE 0 ///< タイマ同期制御の周期（Hz）。ビルド時に選ぶ（CMake の CONTROL_RATE_HZ）
+#endif
+
+/// タイマ同期制御の周期（Hz）
+/// 0 ならエンコーダ通知を受けた appTask で制御する（100Hz、メッセージ処理の遅れがそのまま揺らぎになる）。
+/// 1000 〜 5000 なら ENC_UPDATE_TIM をこの周期で動かし、最高優先度にした appTask がタイマに同期して制御する。
+constexpr uint32_t CONTROL_RATE_HZ = CONTROL_RATE;
+/// 制御周期（Hz）
+constexpr uint32_t CONTROL_TICK_HZ = CONTROL_RATE_HZ ? CONTROL_RATE_HZ : 100;
+/// ENC_UPDATE_TIM のカウンタ周波数（Hz）。84MHz / (プリスケーラ 99 + 1)
+constexpr uint32_t ENC_UPDATE_TIM_CLOCK_HZ = 840000;
+/// エンコーダのカウンタを全てハードウェアで同時にラッチするか
+/// true なら ENC_MOTOR1_TIM のトリガ出力で他のエンコーダTIMのキャプチャを同時に起こし、１つの時刻で全軸のサンプルを揃える。
+/// false ならエンコーダ更新タイマ割り込みの中でカウンタを順に読む（割り込みの実行時間だけ軸ごとに読む時刻がずれる）。
+constexpr bool ENC_SYNC_LATCH = true;
+/// 電流・電圧の計測周期（Hz）。電流ループはこの周期で新しい電流値を受け取った時だけ動く。
+/// INA219 の変換時間（12bit のシャント電圧とバス電圧で約1.06ms）より長く、I2C(400kHz)で全センサを読み切れる周期にする。
+constexpr uint32_t SENSOR_RATE_HZ = CONTROL_TICK_HZ < 500 ? CONTROL_TICK_HZ : 500;
+
+static_assert(CONTROL_RATE_HZ == 0 || (1000 <= CONTROL_RATE_HZ && CONTROL_RATE_HZ <= 5000), "CONTROL_RATE_HZ must be 0 or 1000-5000");
+static_assert(ENC_UPDATE_TIM_CLOCK_HZ % CONTROL_TICK_HZ == 0, "CONTROL_TICK_HZ must divide the timer clock");
+static_assert(CONTROL_TICK_HZ % SENSOR_RATE_HZ == 0, "CONTROL_TICK_HZ must be a multiple of SENSOR_RATE_HZ");
@@ -0,0 +1,130 @@
+/// @file      control/coordinator.cpp
+/// @author    Hiroshi Mikuriya
+/// @copyright Copyright© 2022 Hiroshi Mikuriya
+///
+/// DO NOT USE THIS SOFTWARE WITHOUT THE SOFTWARE LICENSE AGREEMENT.
+
+#include "coordinator.h"
+#include "motor_bank.h"
+#include <cmath>
+
+namespace
+{
+constexpr float MAX_GEAR_RATIO = 100.0f; ///< 電子ギアの比率の絶対値の上限
+/// 目標位置・オフセットの絶対値の上限（カウント）。float で整数のカウントを正確に表せる範囲
+constexpr float MAX_POSITION = 16777216.0f;
+
+/// @brief 値が有限で絶対値が上限以下か
+/// @param [in] v 値
+/// @param [in] max 絶対値の上限
+/// @retval true 範囲内
+/// @retval false 範囲外、または NaN・無限大
+inline bool within(float v, float max)
+{
+  return std::isfinite(v) && std::fabs(v) <= max;
+}
+} // namespace
+
+mik::Coordinator::Coordinator(MotorBank &bank) //
+    : bank_(bank),                             //
+      mode_(NONE),                             //
+      master_(0),                              //
+      follower_(0),                            //
+      ratio_(0),                               //
+      offset_(0),                              //
+      axes_(0)                                 //
+{
+}
+bool mik::Coordinator::gear(uint32_t master, uint32_t follower, float ratio, float offset)
+{
+  if (MOTOR_COUNT <= master || MOTOR_COUNT <= follower || master == follower)
+  {
+    return false;
+  }
+  if (!within(ratio, MAX_GEAR_RATIO) || !within(offset, MAX_POSITION))
+  {
+    return false;
+  }
+  stop();
+  mode_ = GEAR;
+  master_ = master;
+  follower_ = follower;
+  ratio_ = ratio;
+  offset_ = offset;
+  return true;
+}
+bool mik::Coordinator::move(uint32_t axes, float const *targets)
+{
+  axes &= (1 << MOTOR_COUNT) - 1;
+  if (!axes)
+  {
+    return false;
+  }
+  for (uint32_t i = 0; i < MOTOR_COUNT; ++i)
+  {
+    if ((axes & (1 << i)) && !within(targets[i], MAX_POSITION))
+    {
+      return false;
+    }
+  }
+  stop();
+  float longest = 0;
+  for (uint32_t i = 0; i < MOTOR_COUNT; ++i)
+  {
+    if (axes & (1 << i))
+    {
+      longest = std::fmax(longest, std::abs(targets[i] - bank_.motor(i).refPosition()));
+    }
+  }
+  for (uint32_t i = 0; i < MOTOR_COUNT; ++i)
+  {
+    if (axes & (1 << i))
+    {
+      float d = std::abs(targets[i] - bank_.motor(i).refPosition());
+      bank_.motor(i).command(targets[i], 0 < longest ? d / longest : 1);
+    }
+  }
+  mode_ = MOVE;
+  axes_ = axes;
+  return true;
+}
+void mik::Coordinator::stop()
+{
+  for (uint32_t i = 0; i < MOTOR_COUNT; ++i)
+  {
+    bank_.motor(i).release();
+  }
+  mode_ = NONE;
+  axes_ = 0;
+}
+void mik::Coordinator::control()
+{
+  if (mode_ == MOVE)
+  {
+    bool arrived = true;
+    for (uint32_t i = 0; i < MOTOR_COUNT; ++i)
+    {
+      arrived = arrived && (!(axes_ & (1 << i)) || bank_.motor(i).arrived());
+    }
+    if (arrived)
+    {
+      mode_ = NONE;
+      axes_ = 0;
+    }
+  }
+  for (uint32_t i = 0; i < MOTOR_COUNT; ++i)
+  {
+    if (mode_ != GEAR || i != follower_)
+    {
+      bank_.motor(i).control();
+    }
+  }
+  if (mode_ == GEAR)
+  {
+    // 主モータのこの周期の指令値を使うので、遅れなく連動する
+    Motor const &m = bank_.motor(master_);
+    Motor &f = bank_.motor(follower_);
+    f.follow(ratio_ * m.refPosition() + offset_, ratio_ * m.refVelocity(), ratio_ * m.refAccel());
+    f.control();
+  }
+}
@@ -0,0 +1,78 @@
+/// @file      control/coordinator.h
+/// @author    Hiroshi Mikuriya
+/// @copyright Copyright© 2022 Hiroshi Mikuriya
+///
+/// DO NOT USE THIS SOFTWARE WITHOUT THE SOFTWARE LICENSE AGREEMENT.
+
+#pragma once
+
+#include "constants.h"
+#include "motor.h"
+
+namespace mik
+{
+class Coordinator;
+class MotorBank;
+} // namespace mik
+
+/// @brief 複数のモータを連動させるクラス
+/// @note 次のどちらか１つを行う。
+///       - 電子ギア：従動モータの指令値を、主モータの指令値 × 比率 + オフセット にする
+///       - 同期移動：複数のモータを同時に動かし始め、同時に止める
+///       モータの制御はこのクラスの control から呼び出す。電子ギアの従動モータは主モータの後に制御する。
+class mik::Coordinator
+{
+  Coordinator() = delete;                               ///< デフォルトコンストラクタ削除
+  Coordinator(Coordinator const &) = delete;            ///< コピーコンストラクタ削除
+  Coordinator(Coordinator &&) = delete;                 ///< moveコンストラクタ削除
+  Coordinator &operator=(Coordinator const &) = delete; ///< 代入演算子削除
+  Coordinator &operator=(Coordinator &&) = delete;      ///< move演算子削除
+
+  /// @brief 連動の種類
+  enum Mode
+  {
+    NONE = 0, ///< 連動なし
+    GEAR,     ///< 電子ギア
+    MOVE,     ///< 同期移動
+  };
+
+  MotorBank &bank_;   ///< 連動させるモータ
+  Mode mode_;         ///< 連動の種類
+  uint32_t master_;   ///< 電子ギアの主モータID
+  uint32_t follower_; ///< 電子ギアの従動モータID
+  float ratio_;       ///< 電子ギアの比率
+  float offset_;      ///< 電子ギアのオフセット
+  uint32_t axes_;     ///< 同期移動中のモータ（ビットマスク）
+
+public:
+  /// @brief コンストラクタ
+  /// @param [in] bank 連動させるモータ
+  explicit Coordinator(MotorBank &bank);
+  /// @brief デストラクタ
+  virtual ~Coordinator() {}
+  /// @brief 電子ギアで連動させる
+  /// @param [in] master 主モータID
+  /// @param [in] follower 従動モータID
+  /// @param [in] ratio 比率（差動駆動なら -1）
+  /// @param [in] offset オフセット
+  /// @retval true 開始した
+  /// @retval false モータIDが不正、または比率・オフセットが有限でないか範囲外
+  /// @note 従動モータが位置制御モードで稼働している間だけ連動する
+  bool gear(uint32_t master, uint32_t follower, float ratio, float offset);
+  /// @brief 同期移動する
+  /// @param [in] axes 動かすモータ（ビットマスク）
+  /// @param [in] targets 目標位置（モータIDの順、MOTOR_COUNT 個。axes に含まないモータの値は使わない）
+  /// @retval true 開始した
+  /// @retval false モータが指定されていない、または目標位置が有限でないか範囲外
+  /// @note 最も遠いモータ以外は、移動距離の比で最大速度・最大加速度を下げて所要時間を揃える。
+  ///       着いた後も目標位置を保つ。ノブに戻すには stop を呼ぶ。
+  bool move(uint32_t axes, float const *targets);
+  /// @brief 連動をやめ、全てのモータをノブの位置に戻す
+  void stop();
+  /// @brief 同期移動中か
+  /// @retval true 移動中
+  /// @retval false 移動していない
+  bool moving() const { return mode_ == MOVE; }
+  /// @brief 全てのモータの制御を計算する（制御周期ごとに呼び出すこと）
+  void control();
+};
@@ -5,13 +5,71 @@
 /// DO NOT USE THIS SOFTWARE WITHOUT THE SOFTWARE LICENSE AGREEMENT.
 
 #include "motor.h"
+#include "constants.h"
+#include "main.h"
 #include <algorithm>
+#include <cmath>
 
 namespace
 {
-constexpr float KP_VELOCITY_CTRL = 0.5f; ///< 速度制御のP制御比率
-constexpr float KI_VELOCITY_CTRL = 0.0f; ///< 速度制御のI制御比率
-constexpr float KD_VELOCITY_CTRL = 0.5f; ///< 速度制御のD制御比率
+// 位置・速度制御のゲインは、速度のフィードバックが10ms間のカウント差だった時に調整した値。
+// 状態観測器の速度に替えてから調整し直していない（観測器の方が遅れが小さいので、同じゲインなら安定側）
+constexpr float KP_POSITION_CTRL = 0.2f;     ///< 位置制御のP制御比率
+constexpr float KP_VELOCITY_CTRL = 0.5f;     ///< 速度制御のP制御比率
+constexpr float KI_VELOCITY_CTRL = 0.0f;     ///< 速度制御のI制御比率（1/s）
+constexpr float KD_VELOCITY_CTRL = 0.005f;   ///< 速度制御のD制御比率（s）。100Hz で調整した１回当たり 0.5 と同じ
+constexpr float KP_CURRENT_CTRL = 0.3f;      ///< 電流制御のP制御比率
+constexpr float KI_CURRENT_CTRL = 30.0f;     ///< 電流制御のI制御比率（1/s）。100Hz で調整した１回当たり 0.3 と同じ
+constexpr float KB_CURRENT_CTRL = 50.0f;     ///< 電流制御のアンチワインドアップ比率（1/s）
+constexpr float VELOCITY_D_FILTER = 0.01f;   ///< 速度制御の微分項フィルタの時定数（s）。エンコーダの量子化ノイズを抑える
+constexpr float MAX_VELOCITY = 4.0f;         ///< 位置制御の最大速度（10ms当たりのカウント数）
+constexpr float CURRENT_LIMIT_MA = 500.0f;   ///< 電流制限値（mA）。負荷がかかってもこれ以上のトルクを出さない
+constexpr float VELOCITY_PER_SECOND = 0.01f; ///< 1秒当たりのカウント数を速度（10ms当たりのカウント数）に換算する係数
+constexpr float TRAJ_MAX_ACCEL = 4000.0f;    ///< 軌道の最大加速度（カウント/s^2）
+constexpr float TRAJ_MAX_JERK = 80000.0f;    ///< 軌道の最大加加速度（カウント/s^3）。0なら台形速度
+constexpr float FF_DEADBAND = 0.5f;          ///< 摩擦補償を加えない速度指令値の範囲（10ms当たりのカウント数）。停止中に出力が振れないようにする
+constexpr float TUNE_AMPLITUDE = 0.3f;       ///< 自動調整のリレー振幅（電流制限値に対する比率）
+constexpr float TUNE_HYSTERESIS = 1.5f;      ///< 自動調整のヒステリシス（10ms当たりのカウント数）。速度の量子化で切り替わらないようにする
+constexpr uint32_t TUNE_CYCLES = 4;          ///< 自動調整で平均する振動の周期数
+constexpr float TUNE_TIMEOUT = 10.0f;        ///< 自動調整を打ち切るまでの時間（s）
+constexpr float OBSERVER_THETA = 0.9f;       ///< 状態観測器の減衰率（制御周期 1kHz で約10周期分の記憶）
+constexpr float OBSERVER_INPUT_GAIN = 0.0f;  ///< 状態観測器の入力ゲイン（電流制限値で出る加速度、カウント/s^2）。0なら電流を使わない
+constexpr float OBSERVER_SPEED_GAIN = 0.2f;  ///< 状態観測器の速度をM/T法の速度に寄せる比率。M/T法は高速ほど正確で、遅れも小さい
+constexpr float OBSERVER_MAX_DT = 0.1f;      ///< エンコーダ値がこれより長く途切れたら、状態観測器を推定し直す（s）
+constexpr float MAX_GAIN = 1000.0f;          ///< 受け付けるゲイン・フィードフォワード係数の上限。これより大きい値は送信側の誤りとみなす
+/// 電流ループの実行間隔（制御周期の何回に１回か）。実際には新しい電流値を受け取った周期で動く
+constexpr uint32_t CURRENT_LOOP_DIV = CONTROL_TICK_HZ / SENSOR_RATE_HZ;
+/// 外側のループの最大の実行間隔（制御周期の何回に１回か）。タイマ同期制御の前と同じ 100Hz より遅くしない
+constexpr uint32_t MAX_LOOP_DIV = CONTROL_TICK_HZ / 100;
+/// 速度ループの実行間隔（制御周期の何回に１回か）。内側の電流ループが追従できるように、その半分の周波数にする
+constexpr uint32_t VELOCITY_LOOP_DIV = std::min(2 * CURRENT_LOOP_DIV, MAX_LOOP_DIV);
+/// 位置ループの実行間隔（制御周期の何回に１回か）。内側の速度ループの半分の周波数にする
+constexpr uint32_t POSITION_LOOP_DIV = std::min(2 * VELOCITY_LOOP_DIV, MAX_LOOP_DIV);
+static_assert(100 <= CONTROL_TICK_HZ / POSITION_LOOP_DIV, "outer loops must not run slower than 100 Hz");
+/// 電流ループの実行周期（s）
+constexpr float CURRENT_LOOP_DT = static_cast<float>(CURRENT_LOOP_DIV) / CONTROL_TICK_HZ;
+/// 速度ループの実行周期（s）
+constexpr float VELOCITY_LOOP_DT = static_cast<float>(VELOCITY_LOOP_DIV) / CONTROL_TICK_HZ;
+/// 起動時のゲイン
+constexpr mik::MotorGains DEFAULT_GAINS = {
+    KP_POSITION_CTRL, //
+    KP_VELOCITY_CTRL, //
+    KI_VELOCITY_CTRL, //
+    KD_VELOCITY_CTRL, //
+    KP_CURRENT_CTRL,  //
+    KI_CURRENT_CTRL,  //
+};
+
+/// @brief 値が有限で範囲内か
+/// @param [in] min 最小値
+/// @param [in] v 値
+/// @param [in] max 最大値
+/// @retval true 範囲内
+/// @retval false 範囲外、または NaN・無限大
+inline bool within(float min, float v, float max)
+{
+  return std::isfinite(v) && min <= v && v <= max;
+}
 
 /// @brief 値を範囲内に収める
 /// @tparam T 値の型
@@ -32,107 +90,269 @@ inline void compress(T const &min, T &v, T const &max)
 }
 } // namespace
 
-void mik::Motor::controlPosition()
+void mik::Motor::updateObserver()
 {
-  int32_t d = encoder_.get() - nob_.get();
-  if (0 < d)
+  uint32_t stamp = signals_->stamp;
+  if (stamp == stamp_)
   {
-    controlVelocity(-2);
+    return; // 前回の制御周期から新しいエンコーダ値が届いていない
   }
-  else if (d < 0)
+  float dt = static_cast<float>(stamp - stamp_) / SystemCoreClock;
+  stamp_ = stamp;
+  float speed = signals_->speed[index_];
+  if (OBSERVER_MAX_DT < dt)
   {
-    controlVelocity(2);
+    observer_.reset(encoder(), speed); // 起動直後や通知が途切れた後は、間隔が長すぎて予測が当てにならない
+    return;
   }
-  else
+  observer_.update(static_cast<float>(encoder()), dt, measuredCurrent());
+  observer_.correctVelocity(speed);
+}
+void mik::Motor::controlPosition()
+{
+  correction_ = positionPID_.calc(refPosition_, observer_.position());
+}
+float mik::Motor::feedbackVelocity() const
+{
+  return observer_.velocity() * VELOCITY_PER_SECOND; // 単位は従来の 10ms当たりのカウント数 に揃えて、ゲインを変えずに済むようにする
+}
+float mik::Motor::measuredCurrent() const
+{
+  // INA219はモータドライバの電源側で測るので向きが分からない。駆動方向の符号を付ける。
+  float cur = std::abs(getCurrent()) / CURRENT_LIMIT_MA;
+  return signals_->power[index_] < 0 ? -cur : cur;
+}
+void mik::Motor::controlVelocity(float targetVelocity)
+{
+  float ff = ff_.kV * refVelocity_ + ff_.kA * refAccel_;
+  if (FF_DEADBAND < std::abs(refVelocity_))
   {
-    controlVelocity(0);
+    ff += refVelocity_ < 0 ? -ff_.kC : ff_.kC; // 静止摩擦を越えるまで偏差が溜まるのを待たない
   }
+  targetCurrent_ = velocityPID_.calc(targetVelocity, feedbackVelocity(), ff);
 }
-void mik::Motor::controlVelocity(int32_t targetVelocity)
+void mik::Motor::controlCurrent()
 {
-  power_ = velocityPID_.calc(targetVelocity, velocity_);
+  power() = currentPID_.calc(targetCurrent_, measuredCurrent());
 }
 void mik::Motor::reset()
 {
-  if (running_)
+  if (isRunning())
   {
-    led_.high();
+    positionPID_.reset();
     velocityPID_.reset();
+    currentPID_.reset();
+  }
+  tick_ = 0;
+  reference_ = KNOB;
+  observer_.reset(encoder(), observer_.velocity());                // エンコーダ値を0に戻した場合に備えて位置だけ合わせ直す
+  trajectory_.reset(encoder(), signals_->motion[index_].velocity); // 回っている途中から位置制御を始めても急停止しない
+  trajectory_.setScale(1);
+  tuner_.reset();
+  targetVelocity_ = 0;
+  correction_ = 0;
+  targetCurrent_ = 0;
+  refPosition_ = encoder();
+  refVelocity_ = 0;
+  refAccel_ = 0;
+  power() = 0;
+}
+bool mik::Motor::setGains(MotorGains const &gains)
+{
+  float const values[] = {gains.kpPosition, gains.kpVelocity, gains.kiVelocity, gains.kdVelocity, gains.kpCurrent, gains.kiCurrent};
+  for (float v : values)
+  {
+    if (!within(0.0f, v, MAX_GAIN))
+    {
+      return false;
+    }
   }
-  else
+  pendingGains_ = gains;
+  gainsPending_ = true;
+  return true;
+}
+bool mik::Motor::setFeedforward(MotorFeedforward const &ff)
+{
+  // kC は電流制限値に対する比率なので 1 を超えると、それだけで出力が飽和する
+  if (!within(0.0f, ff.kV, MAX_GAIN) || !within(0.0f, ff.kA, MAX_GAIN) || !within(0.0f, ff.kC, 1.0f))
   {
-    led_.low();
+    return false;
   }
+  pendingFf_ = ff;
+  ffPending_ = true;
+  return true;
+}
+void mik::Motor::applyGains(MotorGains const &gains)
+{
+  gains_ = gains;
+  // I・D は1秒当たりの値なので、各ループの実行周期で１回当たりの値に換算する
+  float ki = gains.kiVelocity * VELOCITY_LOOP_DT;
+  positionPID_.setGains(gains.kpPosition, 0, 0);
+  velocityPID_.setGains(gains.kpVelocity, ki, gains.kdVelocity / VELOCITY_LOOP_DT);
+  velocityPID_.setLimits(-1.0f, 1.0f, gains.kpVelocity != 0 ? ki / gains.kpVelocity : 0); // 目安 kb = ki / kp
+  currentPID_.setGains(gains.kpCurrent, gains.kiCurrent * CURRENT_LOOP_DT, 0);
 }
 
-mik::Motor::Motor(                   //
-    TIM_TypeDef *pwmTim,             //
-    setPwmProc setPwm,               //
-    Gpio const &in1,                 //
-    Gpio const &in2,                 //
-    Gpio const &led)                 //
-    : pwmTim_(pwmTim),               //
-      setPwm_(setPwm),               //
-      in1_(in1),                     //
-      in2_(in2),                     //
-      led_(led),                     //
-      encoder_(),                    //
-      nob_(),                        //
-      running_(false),               //
-      mode_(POSITION),               //
-      power_(0),                     //
-      current_(0),                   //
-      busVoltage_(0),                //
-      velocity_(0),                  //
-      velocityPID_(KP_VELOCITY_CTRL, //
-                   KI_VELOCITY_CTRL, //
-                   KD_VELOCITY_CTRL) //
+mik::Motor::Motor(MotorSignals *signals, uint32_t index) //
+    : signals_(signals),                                 //
+      index_(index),                                     //
+      mode_(POSITION),                                   //
+      tick_(0),                                          //
+      targetVelocity_(0),                                //
+      correction_(0),                                    //
+      targetCurrent_(0),                                 //
+      reference_(KNOB),                                  //
+      command_(0),                                       //
+      refPosition_(0),                                   //
+      refVelocity_(0),                                   //
+      refAccel_(0),                                      //
+      positionPID_(0, 0, 0),                             //
+      velocityPID_(0, 0, 0),                             //
+      currentPID_(0, 0, 0),                              //
+      trajectory_(1.0f / CONTROL_TICK_HZ,                //
+                  MAX_VELOCITY / VELOCITY_PER_SECOND,    //
+                  TRAJ_MAX_ACCEL,                        //
+                  TRAJ_MAX_JERK),                        //
+      tuner_(VELOCITY_LOOP_DT,                           //
+             TUNE_AMPLITUDE,                             //
+             TUNE_HYSTERESIS,                            //
+             TUNE_CYCLES,                                //
+             TUNE_TIMEOUT),                              //
+      observer_(OBSERVER_THETA),                         //
+      stamp_(0),                                         //
+      gains_(DEFAULT_GAINS),                             //
+      pendingGains_(DEFAULT_GAINS),                      //
+      gainsPending_(false),                              //
+      ff_(),                                             //
+      pendingFf_(),                                      //
+      ffPending_(false)                                  //
 {
+  positionPID_.setLimits(-MAX_VELOCITY, MAX_VELOCITY, 0);
+  velocityPID_.setDerivativeFilter(VELOCITY_D_FILTER / (VELOCITY_D_FILTER + VELOCITY_LOOP_DT));
+  velocityPID_.setSetpointWeights(1.0f, 0.0f); // 目標速度が急に変わっても微分項で出力が跳ねないようにする
+  currentPID_.setLimits(-1.0f, 1.0f, std::min(1.0f, KB_CURRENT_CTRL * CURRENT_LOOP_DT));
+  observer_.setInputGain(OBSERVER_INPUT_GAIN);
+  observer_.setSpeedGain(OBSERVER_SPEED_GAIN);
+  applyGains(DEFAULT_GAINS);
   reset();
 }
+bool mik::Motor::tunedGains(MotorGains &gains) const
+{
+  gains = gains_;
+  return tuner_.suggest(gains.kpVelocity, gains.kiVelocity, gains.kdVelocity);
+}
 void mik::Motor::changeRunningMode()
 {
-  running_ = !running_;
+  signals_->running[index_] = !isRunning();
   reset();
 }
 void mik::Motor::changeControlMode()
 {
+  MotorGains tuned;
+  if (mode_ == AUTOTUNE && tunedGains(tuned))
+  {
+    setGains(tuned);
+  }
   mode_ = static_cast<MotorMode>((mode_ + 1) % MODE_COUNT);
   reset();
 }
+void mik::Motor::command(float target, float scale)
+{
+  if (reference_ == FOLLOW)
+  {
+    trajectory_.reset(refPosition_, refVelocity_ / VELOCITY_PER_SECOND);
+  }
+  reference_ = COMMAND;
+  command_ = target;
+  trajectory_.setScale(scale);
+}
+void mik::Motor::follow(float position, float velocity, float accel)
+{
+  reference_ = FOLLOW;
+  refPosition_ = position;
+  refVelocity_ = velocity;
+  refAccel_ = accel;
+}
+void mik::Motor::release()
+{
+  if (reference_ == FOLLOW)
+  {
+    trajectory_.reset(refPosition_, refVelocity_ / VELOCITY_PER_SECOND);
+  }
+  reference_ = KNOB;
+  trajectory_.setScale(1);
+}
+bool mik::Motor::arrived() const
+{
+  if (reference_ != COMMAND || !isRunning() || mode_ != POSITION)
+  {
+    return true;
+  }
+  return trajectory_.velocity() == 0 && trajectory_.position() == command_;
+}
 void mik::Motor::control()
 {
-  if (running_)
+  if (gainsPending_)
+  {
+    gainsPending_ = false;
+    applyGains(pendingGains_); // 制御周期の境目でまとめて差し替える
+  }
+  if (ffPending_)
+  {
+    ffPending_ = false;
+    ff_ = pendingFf_;
+  }
+  updateObserver(); // 停止中も追従させておき、動かし始めから推定値を使う
+  bool freshCurrent = signals_->freshCurrent[index_];
+  signals_->freshCurrent[index_] = false;
+  if (isRunning())
   {
     switch (mode_)
     {
     case POSITION:
-      controlPosition();
+      if (reference_ != FOLLOW)
+      {
+        trajectory_.update(reference_ == COMMAND ? command_ : nob()); // 軌道は毎周期進め、位置ループは補正だけを受け持つ
+        refPosition_ = trajectory_.position();
+        refVelocity_ = trajectory_.velocity() * VELOCITY_PER_SECOND;
+        refAccel_ = trajectory_.acceleration();
+      }
+      if (reference_ == COMMAND && arrived())
+      {
+        trajectory_.setScale(1); // 着いたら同期移動用の倍率を戻す
+      }
+      if (tick_ % POSITION_LOOP_DIV == 0)
+      {
+        controlPosition();
+      }
+      targetVelocity_ = refVelocity_ + correction_;
       break;
     case VELOCITY:
-      controlVelocity(nob_.get());
+    case AUTOTUNE:
+      targetVelocity_ = nob();
+      refPosition_ = encoder();
+      refVelocity_ = targetVelocity_;
+      refAccel_ = signals_->nobMotion[index_].velocity / VELOCITY_PER_SECOND; // ノブを回す速さが目標速度の変化率
       break;
     default:
       break;
     }
-    compress(-1.0f, power_, 1.0f);
-    if (0 < power_)
+    if (tick_ % VELOCITY_LOOP_DIV == 0)
     {
-      in1_.high();
-      in2_.low();
+      if (mode_ == AUTOTUNE)
+      {
+        targetCurrent_ = tuner_.step(targetVelocity_, feedbackVelocity()); // 速度ループの代わりにリレーで振動させる
+      }
+      else
+      {
+        controlVelocity(targetVelocity_);
+      }
     }
-    else
+    if (freshCurrent)
     {
-      in1_.low();
-      in2_.high();
+      controlCurrent(); // 同じ電流値で何度も積分しないように、センサ値が更新された時だけ動かす
     }
+    ++tick_;
+    compress(-1.0f, power(), 1.0f);
   }
-  else
-  {
-    in1_.low();
-    in2_.low();
-  }
-  uint32_t max = LL_TIM_GetAutoReload(pwmTim_);
-  uint32_t pwm = static_cast<uint32_t>(max * std::abs(power_));
-  setPwm_(pwmTim_, pwm);
 }
\ No newline at end of file
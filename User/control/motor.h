@@ -6,25 +6,51 @@
 
 #pragma once
 
-#include "gpio.hpp"
-#include "main.h"
+#include "constants.h"
+#include "motor_gains.h"
 #include "pid.hpp"
-#include "rotary.hpp"
+#include "relay_tuner.hpp"
+#include "savitzky_golay.hpp"
+#include "state_observer.hpp"
+#include "trajectory.hpp"
 
 namespace mik
 {
 class Motor;
+struct MotorSignals;
 
 /// @brief モータモード定義
 enum MotorMode
 {
   POSITION = 0, ///< 位置制御モード
   VELOCITY,     ///< 速度制御モード
+  AUTOTUNE,     ///< 速度制御の自動調整モード（リレーフィードバック）
   MODE_COUNT,   ///< モード総数
 };
 } // namespace mik
 
+/// @brief 全モータの入出力値
+/// @note モータごとの構造体ではなく項目ごとの配列で持つ。センサ値の反映とPWM出力は、
+///       全モータ分を１つのループで連続したメモリに対して行う。
+struct mik::MotorSignals
+{
+  int32_t encoder[MOTOR_COUNT];    ///< エンコーダ値
+  int32_t nob[MOTOR_COUNT];        ///< ノブの回転位置
+  int32_t velocity[MOTOR_COUNT];   ///< 速度（10ms当たりのカウント数）
+  float speed[MOTOR_COUNT];        ///< M/T法で求めた速度（カウント/s）
+  uint32_t stamp;                  ///< encoder・nob・velocity・speed をラッチした時刻（DWTのサイクル数）
+  float current[MOTOR_COUNT];      ///< 電流値
+  float busVoltage[MOTOR_COUNT];   ///< バス電圧
+  float shuntVoltage[MOTOR_COUNT]; ///< シャント電圧
+  bool freshCurrent[MOTOR_COUNT];  ///< 前回の電流ループ以降に current が更新されたか
+  float power[MOTOR_COUNT];        ///< PWM制御の比率（-1.0 〜 1.0）
+  bool running[MOTOR_COUNT];       ///< 稼働状態 @arg true 稼働中 @arg false 停止中
+  Motion motion[MOTOR_COUNT];      ///< エンコーダ値の履歴から推定したモータの動き（カウント、/s）
+  Motion nobMotion[MOTOR_COUNT];   ///< ノブの回転位置の履歴から推定したノブの動き
+};
+
 /// @brief モータクラス
+/// @note １つのモータの制御状態を持つ。入出力値は MotorSignals の自分の列を読み書きする。
 class mik::Motor
 {
   Motor() = delete;                         ///< デフォルトコンストラクタ削除
@@ -33,90 +59,157 @@ class mik::Motor
   Motor &operator=(Motor const &) = delete; ///< moveコンストラクタ削除
   Motor &operator=(Motor &&) = delete;      ///< move演算子削除
 
-  /// PWM信号を送る関数型
-  typedef void (*setPwmProc)(TIM_TypeDef *, uint32_t);
+  /// @brief 位置制御の指令値の与え方
+  enum Reference
+  {
+    KNOB = 0, ///< ノブの位置へ軌道を生成する
+    COMMAND,  ///< command で与えた位置へ軌道を生成する
+    FOLLOW,   ///< follow で与えた指令値をそのまま使う
+  };
 
-  TIM_TypeDef *pwmTim_;     ///< PWM TIM
-  setPwmProc setPwm_;       ///< モータドライバにPWM信号を送る関数
-  Gpio in1_;                ///< モータドライバに回転方向を指示するGPIO1
-  Gpio in2_;                ///< モータドライバに回転方向を指示するGPIO2
-  Gpio led_;                ///< LED制御GPIO
-  Rotary<int32_t> encoder_; ///< エンコーダ値
-  Rotary<int32_t> nob_;     ///< ノブの回転位置
-  bool running_;            ///< 稼働状態 @arg true 稼働中 @arg false 停止中
-  MotorMode mode_;          ///< モータモード
-  float power_;             ///< PWM制御の比率（-1.0 〜 1.0）
-  float current_;           ///< 電流値
-  float busVoltage_;        ///< バス電圧
-  float shuntVoltage_;      ///< シャント電圧
-  int32_t velocity_;        ///< 速度
-  PID velocityPID_;         ///< 速度制御のPID制御計算機
+  MotorSignals *signals_;      ///< 全モータの入出力値
+  uint32_t index_;             ///< モータID（signals_ の列）
+  MotorMode mode_;             ///< モータモード
+  uint32_t tick_;              ///< 制御周期のカウンタ
+  float targetVelocity_;       ///< 目標速度（軌道の速度指令値 + 位置ループの補正）
+  float correction_;           ///< 位置ループの出力（軌道の位置指令値との偏差を埋める速度）
+  float targetCurrent_;        ///< 目標電流（速度ループの出力、電流制限値に対する比率 -1.0 〜 1.0）
+  Reference reference_;        ///< 位置制御の指令値の与え方
+  float command_;              ///< command で与えた目標位置
+  float refPosition_;          ///< 位置指令値
+  float refVelocity_;          ///< フィードフォワードに使う速度指令値（10ms当たりのカウント数）
+  float refAccel_;             ///< フィードフォワードに使う加速度指令値（カウント/s^2）
+  PID positionPID_;            ///< 位置制御のPID制御計算機
+  PID velocityPID_;            ///< 速度制御のPID制御計算機
+  PID currentPID_;             ///< 電流制御のPID制御計算機
+  Trajectory trajectory_;      ///< 位置制御の軌道生成器
+  RelayTuner tuner_;           ///< 速度制御の自動調整器
+  StateObserver observer_;     ///< 位置・速度・加速度の状態観測器（制御のフィードバック値）
+  uint32_t stamp_;             ///< 状態観測器に最後に与えたエンコーダ値のラッチ時刻（DWTのサイクル数）
+  MotorGains gains_;           ///< 制御中のゲイン
+  MotorGains pendingGains_;    ///< 次の制御周期から使うゲイン
+  bool gainsPending_;          ///< pendingGains_ が未反映か
+  MotorFeedforward ff_;        ///< 制御中のフィードフォワード係数
+  MotorFeedforward pendingFf_; ///< 次の制御周期から使うフィードフォワード係数
+  bool ffPending_;             ///< pendingFf_ が未反映か
 
-  /// @brief 位置制御する
+  /// @brief 新しいエンコーダ値が届いていれば、サンプルの時刻の差で状態観測器を更新する
+  void updateObserver();
+  /// @brief 位置制御する（外側ループ）
   void controlPosition();
-  /// @brief 速度制御する
+  /// @brief 速度制御する（中間ループ）
   /// @param [in] targetVelocity 目標速度
-  void controlVelocity(int32_t targetVelocity);
+  void controlVelocity(float targetVelocity);
+  /// @brief 電流制御する（内側ループ）
+  void controlCurrent();
+  /// @brief 速度ループのフィードバック値を取得する
+  /// @return 状態観測器で推定した速度（10ms当たりのカウント数）
+  float feedbackVelocity() const;
+  /// @brief 電流の測定値を取得する
+  /// @return 電流制限値に対する比率（駆動方向の符号付き）
+  float measuredCurrent() const;
+  /// @brief PWM制御の比率を参照する @return PWM制御の比率
+  float &power() { return signals_->power[index_]; }
   /// @brief モード切り替えリセット等
   void reset();
+  /// @brief ゲインを各PIDに反映する
+  /// @param [in] gains ゲイン
+  void applyGains(MotorGains const &gains);
 
 public:
   /// @brief コンストラクタ
-  /// @param [in] pwmTim PWM TIM
-  /// @param [in] setPwm モータドライバにPWM信号を送る関数
-  /// @param [in] in1 モータドライバに回転方向を指示するGPIO1
-  /// @param [in] in2 モータドライバに回転方向を指示するGPIO2
-  /// @param [in] led LEDを制御するGPIO
-  explicit Motor(TIM_TypeDef *pwmTim, //
-                 setPwmProc setPwm,   //
-                 Gpio const &in1,     //
-                 Gpio const &in2,     //
-                 Gpio const &led);
+  /// @param [in] signals 全モータの入出力値
+  /// @param [in] index モータID
+  explicit Motor(MotorSignals *signals, uint32_t index);
   /// @brief デストラクタ
   virtual ~Motor() {}
-  /// @brief 電流値を設定する
-  /// @param [in] cur 電流値
-  void setCurrent(float cur) { current_ = cur; }
   /// @brief 電流値を取得する
   /// @return 電流値
-  float getCurrent() const { return current_; }
-  /// @brief バス電圧値を設定する
-  /// @param [in] v バス電圧値
-  void setBusVoltage(float v) { busVoltage_ = v; }
+  float getCurrent() const { return signals_->current[index_]; }
   /// @brief バス電圧値を取得する
   /// @return バス電圧値
-  float getBusVoltage() const { return busVoltage_; }
-  /// @brief シャント電圧値を設定する
-  /// @param [in] v シャント電圧値
-  void setShuntVoltage(float v) { shuntVoltage_ = v; }
+  float getBusVoltage() const { return signals_->busVoltage[index_]; }
   /// @brief シャント電圧値を取得する
   /// @return シャント電圧値
-  float getShuntVoltage() const { return shuntVoltage_; }
-  /// @brief 速度を設定する
-  /// @param [in] velocity  速度
-  void setVelocity(int32_t velocity) { velocity_ = velocity; }
+  float getShuntVoltage() const { return signals_->shuntVoltage[index_]; }
   /// @brief 速度を取得する
   /// @return 速度
-  int32_t getVelocity() const { return velocity_; }
+  int32_t getVelocity() const { return signals_->velocity[index_]; }
+  /// @brief M/T法で求めた速度を取得する
+  /// @return 速度（カウント/s）。getVelocity と違い、低速でも量子化されない
+  float getSpeed() const { return signals_->speed[index_]; }
   /// @brief 稼働状態を変更する
   void changeRunningMode();
   /// @brief 制御状態を変更する
+  /// @note 自動調整モードを抜ける時に調整が完了していれば、求めたゲインを使い始める
   void changeControlMode();
   /// @brief 稼働状態を取得する
   /// @retval true 稼働中
   /// @retval false 停止中
-  bool isRunning() const { return running_; }
+  bool isRunning() const { return signals_->running[index_]; }
   /// @brief モードを取得する
   /// @return モード
   MotorMode mode() const { return mode_; }
-  /// @brief エンコーダを取得する @return エンコーダ
-  Rotary<int32_t> &encoder() { return encoder_; }
-  /// @brief エンコーダを取得する @return エンコーダ
-  Rotary<int32_t> const &encoder() const { return encoder_; }
-  /// @brief ノブを取得する @return ノブ
-  Rotary<int32_t> &nob() { return nob_; }
-  /// @brief ノブを取得する @return ノブ
-  Rotary<int32_t> const &nob() const { return nob_; }
+  /// @brief エンコーダ値を取得する @return エンコーダ値
+  int32_t encoder() const { return signals_->encoder[index_]; }
+  /// @brief ノブの回転位置を取得する @return ノブの回転位置
+  int32_t nob() const { return signals_->nob[index_]; }
+  /// @brief ゲインを変更する
+  /// @param [in] gains ゲイン
+  /// @retval true 変更した
+  /// @retval false 有限でない、負、または大きすぎる値を含むので変更しなかった
+  /// @note 次の control の先頭で全てのPIDにまとめて反映するので、制御周期の途中で新旧のゲインが混ざらない。
+  ///       control と同じタスクから呼び出すこと。他のタスクからは MOTOR_GAINS_REQ を送る。
+  bool setGains(MotorGains const &gains);
+  /// @brief フィードフォワード係数を変更する
+  /// @param [in] ff フィードフォワード係数
+  /// @retval true 変更した
+  /// @retval false 有限でない、または範囲外の値を含むので変更しなかった
+  /// @note setGains と同じく次の control の先頭で反映する。他のタスクからは MOTOR_FEEDFORWARD_REQ を送る。
+  bool setFeedforward(MotorFeedforward const &ff);
+  /// @brief 制御中のフィードフォワード係数を取得する
+  /// @return フィードフォワード係数
+  MotorFeedforward const &feedforward() const { return ff_; }
+  /// @brief 制御中のゲインを取得する
+  /// @return ゲイン
+  MotorGains const &gains() const { return gains_; }
+  /// @brief 自動調整で求めたゲインを取得する
+  /// @param [out] gains 制御中のゲインの速度制御分を置き換えたゲイン
+  /// @retval true 取得した
+  /// @retval false 自動調整が完了していない
+  bool tunedGains(MotorGains &gains) const;
+  /// @brief 速度制御の自動調整器を取得する @return 自動調整器
+  RelayTuner const &tuner() const { return tuner_; }
+  /// @brief 状態観測器を取得する @return 状態観測器
+  StateObserver const &observer() const { return observer_; }
+  /// @brief ノブの代わりに目標位置を与える
+  /// @param [in] target 目標位置
+  /// @param [in] scale 軌道の最大速度・最大加速度に掛ける倍率（0 〜 1）
+  /// @note 位置制御モードでのみ有効。モード・稼働状態を変えるとノブに戻る。
+  void command(float target, float scale);
+  /// @brief 軌道生成を使わず、位置・速度・加速度の指令値を直接与える
+  /// @param [in] position 位置指令値
+  /// @param [in] velocity 速度指令値（10ms当たりのカウント数）
+  /// @param [in] accel 加速度指令値（カウント/s^2）
+  /// @note 制御周期ごとに control の前に呼び出すこと。位置制御モードでのみ有効。
+  void follow(float position, float velocity, float accel);
+  /// @brief command / follow をやめてノブの位置へ戻る
+  /// @note follow していた場合は、その時の位置と速度から軌道を引き継ぐ
+  void release();
+  /// @brief command で与えた目標位置に着いたか
+  /// @retval true 着いた（command していない、または位置制御で稼働していない場合も含む）
+  /// @retval false 移動中
+  bool arrived() const;
+  /// @brief 位置指令値を取得する @return 位置指令値（位置制御モード以外はエンコーダ値）
+  float refPosition() const { return refPosition_; }
+  /// @brief 速度指令値を取得する @return 速度指令値（10ms当たりのカウント数）
+  float refVelocity() const { return refVelocity_; }
+  /// @brief 加速度指令値を取得する @return 加速度指令値（カウント/s^2）
+  float refAccel() const { return refAccel_; }
   /// @brief モータ制御する（定期的に呼び出すこと）
+  /// @note 電流ループは新しい電流値を受け取った周期（SENSOR_RATE_HZ）だけ、速度ループはその半分、
+  ///       位置ループはさらに半分の周波数で実行する。ただし外側のループも 100Hz より遅くはしない
+  ///       （CONTROL_RATE_HZ が 0 なら全てのループが 100Hz で動く）。
+  ///       求めたPWM制御の比率は MotorSignals::power に書き込み、出力は MotorBank がまとめて行う。
   void control();
 };
\ No newline at end of file
@@ -0,0 +1,86 @@
+/// @file      control/motor_bank.cpp
+/// @author    Hiroshi Mikuriya
+/// @copyright Copyright© 2022 Hiroshi Mikuriya
+///
+/// DO NOT USE THIS SOFTWARE WITHOUT THE SOFTWARE LICENSE AGREEMENT.
+
+#include "motor_bank.h"
+#include <cmath>
+
+mik::MotorBank::MotorBank(MotorPort const *ports) //
+    : ports_(ports),                              //
+      signals_(),                                 //
+      coordinator_(*this),                        //
+      history_(),                                 //
+      estimator_()                                //
+{
+  for (uint32_t i = 0; i < MOTOR_COUNT; ++i)
+  {
+    motors_[i] = makeUnique<Motor>(&signals_, i);
+    auto const &p = ports_[i];
+    LL_TIM_CC_EnableChannel(p.pwmTim, p.pwmChannel);
+    LL_TIM_EnableCounter(p.pwmTim);
+    LL_TIM_EnableAllOutputs(p.pwmTim);
+  }
+}
+void mik::MotorBank::output()
+{
+  for (uint32_t i = 0; i < MOTOR_COUNT; ++i)
+  {
+    auto const &p = ports_[i];
+    float power = signals_.power[i];
+    if (signals_.running[i])
+    {
+      p.led.high();
+      if (0 < power)
+      {
+        p.in1.high();
+        p.in2.low();
+      }
+      else
+      {
+        p.in1.low();
+        p.in2.high();
+      }
+    }
+    else
+    {
+      p.led.low();
+      p.in1.low();
+      p.in2.low();
+    }
+    uint32_t max = LL_TIM_GetAutoReload(p.pwmTim);
+    p.setPwm(p.pwmTim, static_cast<uint32_t>(max * std::abs(power)));
+  }
+}
+void mik::MotorBank::record(uint32_t stamp)
+{
+  int32_t values[2 * MOTOR_COUNT];
+  for (uint32_t i = 0; i < MOTOR_COUNT; ++i)
+  {
+    values[i] = signals_.encoder[i];
+    values[MOTOR_COUNT + i] = signals_.nob[i];
+  }
+  signals_.stamp = stamp;
+  history_.push(stamp, values);
+  float clockHz = static_cast<float>(SystemCoreClock);
+  for (uint32_t i = 0; i < MOTOR_COUNT; ++i)
+  {
+    estimator_.estimate(history_, i, clockHz, signals_.motion[i]);
+    estimator_.estimate(history_, MOTOR_COUNT + i, clockHz, signals_.nobMotion[i]);
+  }
+}
+void mik::MotorBank::resetPosition(uint32_t i)
+{
+  history_.shift(i, -signals_.encoder[i]);
+  history_.shift(MOTOR_COUNT + i, -signals_.nob[i]);
+  signals_.motion[i].position -= signals_.encoder[i];
+  signals_.nobMotion[i].position -= signals_.nob[i];
+  signals_.encoder[i] = 0;
+  signals_.nob[i] = 0;
+}
+void mik::MotorBank::control()
+{
+  coordinator_.control();
+  output();
+}
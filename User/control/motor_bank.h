@@ -0,0 +1,99 @@
+/// @file      control/motor_bank.h
+/// @author    Hiroshi Mikuriya
+/// @copyright Copyright© 2022 Hiroshi Mikuriya
+///
+/// DO NOT USE THIS SOFTWARE WITHOUT THE SOFTWARE LICENSE AGREEMENT.
+
+#pragma once
+
+#include "common/alloc.hpp"
+#include "constants.h"
+#include "coordinator.h"
+#include "gpio.hpp"
+#include "main.h"
+#include "motor.h"
+#include "sample_history.hpp"
+#include "savitzky_golay.hpp"
+#include <algorithm>
+
+namespace mik
+{
+struct MotorPort;
+class MotorBank;
+} // namespace mik
+
+/// @brief モータドライバとLEDの接続
+struct mik::MotorPort
+{
+  TIM_TypeDef *pwmTim;                     ///< PWM TIM
+  uint32_t pwmChannel;                     ///< PWM TIM のチャネル
+  void (*setPwm)(TIM_TypeDef *, uint32_t); ///< モータドライバにPWM信号を送る関数
+  Gpio in1;                                ///< モータドライバに回転方向を指示するGPIO1
+  Gpio in2;                                ///< モータドライバに回転方向を指示するGPIO2
+  Gpio led;                                ///< LED制御GPIO
+};
+
+/// @brief 全モータをまとめて制御するクラス
+/// @note モータ数は MOTOR_COUNT で決まる。入出力値は MotorSignals に項目ごとの配列で持ち、
+///       制御計算の後に全モータ分のPWM出力を１つのループで行う。
+class mik::MotorBank
+{
+  MotorBank() = delete;                             ///< デフォルトコンストラクタ削除
+  MotorBank(MotorBank const &) = delete;            ///< コピーコンストラクタ削除
+  MotorBank(MotorBank &&) = delete;                 ///< moveコンストラクタ削除
+  MotorBank &operator=(MotorBank const &) = delete; ///< 代入演算子削除
+  MotorBank &operator=(MotorBank &&) = delete;      ///< move演算子削除
+
+public:
+  static constexpr uint32_t HISTORY_SIZE = 128; ///< 保持するエンコーダのサンプル数（ESTIMATE_WINDOW の最大値）
+  /// 速度・加速度の推定に使うサンプル数。制御周期によらず約128msの時間幅にする（100Hz で 12、1kHz で 128）。
+  /// 1kHz より速い制御周期では積和の計算量を抑えるために HISTORY_SIZE で打ち切るので、時間幅は短くなる（5kHz で 25.6ms）。
+  /// 精度は test/savitzky_golay_test.cpp
+  static constexpr uint32_t ESTIMATE_WINDOW = std::min<uint32_t>(CONTROL_TICK_HZ * 128 / 1000, HISTORY_SIZE);
+  /// エンコーダの履歴。チャネル i がモータID i のエンコーダ値、MOTOR_COUNT + i がノブの回転位置
+  using History = SampleHistory<2 * MOTOR_COUNT, HISTORY_SIZE>;
+
+private:
+  MotorPort const *ports_;                   ///< モータID順の接続（MOTOR_COUNT 個）
+  MotorSignals signals_;                     ///< 全モータの入出力値
+  UniquePtr<Motor> motors_[MOTOR_COUNT];     ///< モータID順のモータ
+  Coordinator coordinator_;                  ///< モータの連動
+  History history_;                          ///< エンコーダの履歴
+  SavitzkyGolay<ESTIMATE_WINDOW> estimator_; ///< 履歴から動きを推定する
+
+  /// @brief 全モータ分のPWM信号・回転方向・LEDを出力する
+  void output();
+
+public:
+  /// @brief コンストラクタ
+  /// @param [in] ports モータID順の接続（MOTOR_COUNT 個）
+  explicit MotorBank(MotorPort const *ports);
+  /// @brief デストラクタ
+  virtual ~MotorBank() {}
+  /// @brief モータを取得する
+  /// @param [in] i モータID
+  /// @return モータ
+  Motor &motor(uint32_t i) { return *motors_[i]; }
+  /// @brief モータを取得する
+  /// @param [in] i モータID
+  /// @return モータ
+  Motor const &motor(uint32_t i) const { return *motors_[i]; }
+  /// @brief 全モータの入出力値を取得する
+  /// @return 入出力値（センサ値はここへ書き込む）
+  MotorSignals &signals() { return signals_; }
+  /// @brief エンコーダの履歴を取得する
+  /// @return エンコーダの履歴（異常が起きる前の動きを遡って調べる場合等に使う）
+  History const &history() const { return history_; }
+  /// @brief signals に書き込んだエンコーダ値を履歴に加え、動きを推定し直す
+  /// @param [in] stamp サンプルの時刻（DWTのサイクル数）
+  void record(uint32_t stamp);
+  /// @brief モータとノブのエンコーダ値を0に戻す
+  /// @param [in] i モータID
+  /// @note 履歴も新しい原点にずらすので、推定した速度等は途切れない
+  void resetPosition(uint32_t i);
+  /// @brief モータの連動を取得する
+  /// @return モータの連動
+  Coordinator &coordinator() { return coordinator_; }
+  /// @brief 全モータを制御する（制御周期ごとに呼び出すこと）
+  void control();
+};
@@ -0,0 +1,35 @@
+/// @file      control/motor_gains.h
+/// @author    Hiroshi Mikuriya
+/// @copyright Copyright© 2022 Hiroshi Mikuriya
+///
+/// DO NOT USE THIS SOFTWARE WITHOUT THE SOFTWARE LICENSE AGREEMENT.
+
+#pragma once
+
+namespace mik
+{
+struct MotorGains;
+struct MotorFeedforward;
+}
+
+/// @brief モータ１つ分の制御ゲイン
+/// @note メッセージでそのまま送れるように、float だけを並べる。
+///       I・D は1秒当たりの値で持ち、各ループの実行周期で換算して使うので、制御周期を変えてもゲインは変わらない。
+struct mik::MotorGains
+{
+  float kpPosition; ///< 位置制御のP制御比率
+  float kpVelocity; ///< 速度制御のP制御比率
+  float kiVelocity; ///< 速度制御のI制御比率（1/s）
+  float kdVelocity; ///< 速度制御のD制御比率（s）
+  float kpCurrent;  ///< 電流制御のP制御比率
+  float kiCurrent;  ///< 電流制御のI制御比率（1/s）
+};
+
+/// @brief モータ１つ分の速度制御のフィードフォワード係数
+/// @note 速度ループの出力（目標電流）に kV・v + kA・a + kC・sign(v) を加える。全て0ならフィードバックのみ。
+struct mik::MotorFeedforward
+{
+  float kV; ///< 速度指令値（10ms当たりのカウント数）に掛ける係数
+  float kA; ///< 加速度指令値（カウント/s^2）に掛ける係数
+  float kC; ///< 速度指令値の向きに加えるクーロン摩擦分（電流制限値に対する比率）
+};
@@ -6,6 +6,8 @@
 
 #pragma once
 
+#include <limits>
+
 namespace mik
 {
 class PID;
@@ -13,58 +15,124 @@ class PID;
 
 /// @brief PID制御クラス
 /// @see http://www.picfun.com/motor05.html
+/// @note 位置形で計算する。拡張機能を設定しなければ、増分形（速度形）PIDと同じ出力になる。
+///       ただし初回（生成直後と reset 後）は前回の偏差が無いので微分項を0とし、出力が跳ねないようにする。
+///       拡張機能はインスタンスごとに選んで設定する。
+///       - 出力制限と back-calculation 方式のアンチワインドアップ（setLimits）
+///       - 微分項の一次遅れフィルタ（setDerivativeFilter）
+///       - 目標値の重み付け（setSetpointWeights）
 class mik::PID
 {
   PID() = delete;
 
-  const float kp_; ///< 比例項係数
-  const float ki_; ///< 積分項係数
-  const float kd_; ///< 微分項係数
+  float kp_;       ///< 比例項係数
+  float ki_;       ///< 積分項係数
+  float kd_;       ///< 微分項係数
+  float min_;      ///< 出力の下限
+  float max_;      ///< 出力の上限
+  float kb_;       ///< 出力を制限した量を積分項から差し引く比率
+  float alpha_;    ///< 微分項フィルタの係数（0ならフィルタなし）
+  float b_;        ///< 比例項の目標値の重み
+  float c_;        ///< 微分項の目標値の重み
+  float integral_; ///< 積分項
+  float deriv_;    ///< フィルタ後の微分項
+  float ed1_;      ///< 前回の微分項偏差
   float mvn_;      ///< 今回操作量
-  float mvn1_;     ///< 前回操作量
-  float en_;       ///< 今回の偏差
-  float en1_;      ///< 前回の偏差
-  float en2_;      ///< 前々回の偏差
-
-  /// @brief 今回値を前回値にコピーする
-  void shift()
-  {
-    mvn1_ = mvn_;
-    en2_ = en1_;
-    en1_ = en_;
-  }
+  bool first_;     ///< 初回の計算か（ed1_ が未設定）
 
 public:
   /// @brief コンストラクタ
   /// @param [in] kp Kp
   /// @param [in] ki Ki
   /// @param [in] kd Kd
-  explicit PID(float kp, float ki, float kd) //
-      : kp_(kp), ki_(ki), kd_(kd), mvn_(0), mvn1_(0), en_(0), en1_(0), en2_(0)
+  explicit PID(float kp, float ki, float kd)      //
+      : kp_(kp),                                  //
+        ki_(ki),                                  //
+        kd_(kd),                                  //
+        min_(-std::numeric_limits<float>::max()), //
+        max_(std::numeric_limits<float>::max()),  //
+        kb_(0),                                   //
+        alpha_(0),                                //
+        b_(1),                                    //
+        c_(1),                                    //
+        integral_(0),                             //
+        deriv_(0),                                //
+        ed1_(0),                                  //
+        mvn_(0),                                  //
+        first_(true)                              //
   {
   }
   /// @brief デストラクタ
   virtual ~PID() {}
+  /// @brief 係数を変更する
+  /// @param [in] kp Kp
+  /// @param [in] ki Ki
+  /// @param [in] kd Kd
+  /// @note 積分項は Ki を掛けた値を積算しているので、制御中に Ki を変えても出力は跳ねない
+  void setGains(float kp, float ki, float kd)
+  {
+    kp_ = kp;
+    ki_ = ki;
+    kd_ = kd;
+  }
+  /// @brief 出力を制限する
+  /// @param [in] min 出力の下限
+  /// @param [in] max 出力の上限
+  /// @param [in] kb 制限した量を毎回積分項から差し引く比率（0 〜 1、0ならアンチワインドアップなし）
+  /// @note 積分項が制限の外側へ積み上がるのを防ぐ（back-calculation）。目安は kb = ki / kp。
+  void setLimits(float min, float max, float kb)
+  {
+    min_ = min;
+    max_ = max;
+    kb_ = kb;
+  }
+  /// @brief 微分項に一次遅れフィルタをかける
+  /// @param [in] alpha 前回値の比率（0 〜 1未満、大きいほど強くなまらせる）
+  void setDerivativeFilter(float alpha) { alpha_ = alpha; }
+  /// @brief 目標値の重みを設定する
+  /// @param [in] b 比例項の重み（1なら通常のPID）
+  /// @param [in] c 微分項の重み（0なら測定値だけを微分し、目標値が変わった瞬間に出力が跳ねない）
+  void setSetpointWeights(float b, float c)
+  {
+    b_ = b;
+    c_ = c;
+  }
   /// @brief 制御値を計算する
   /// @param [in] target 目標値
   /// @param [in] fb フィードバック値
   /// @return 出力値
-  float calc(float target, float fb)
+  float calc(float target, float fb) { return calc(target, fb, 0); }
+  /// @brief フィードフォワード付きで制御値を計算する
+  /// @param [in] target 目標値
+  /// @param [in] fb フィードバック値
+  /// @param [in] ff フィードフォワード値（出力に加える）
+  /// @return 出力値
+  /// @note 出力制限とアンチワインドアップはフィードフォワードを加えた後の値で判定する
+  float calc(float target, float fb, float ff)
   {
-    shift();
-    en_ = target - fb;
-    // ΔMVn = Kp(en-en-1) + Ki en + Kd((en-en-1) - (en-1-en-2))
-    float dmvn = kp_ * (en_ - en1_) + ki_ * en_ + kd_ * ((en_ - en1_) - (en1_ - en2_));
-    // MVn = MVn-1 + ΔMVn
-    return mvn_ = mvn1_ + dmvn;
+    // MVn = Kp(b r - y) + ΣKi en + Kd((c r - y)n - (c r - y)n-1)
+    float p = kp_ * (b_ * target - fb);
+    float ed = c_ * target - fb;
+    if (first_)
+    {
+      first_ = false;
+      ed1_ = ed; // 0から測定値までの変化を微分しない
+    }
+    deriv_ = alpha_ * deriv_ + (1 - alpha_) * kd_ * (ed - ed1_);
+    ed1_ = ed;
+    integral_ += ki_ * (target - fb);
+    float mv = p + integral_ + deriv_ + ff;
+    mvn_ = mv < min_ ? min_ : (max_ < mv ? max_ : mv);
+    integral_ += kb_ * (mvn_ - mv);
+    return mvn_;
   }
   /// @brief パラメータ初期化
   void reset()
   {
+    integral_ = 0;
+    deriv_ = 0;
+    ed1_ = 0;
     mvn_ = 0;
-    mvn1_ = 0;
-    en_ = 0;
-    en1_ = 0;
-    en2_ = 0;
+    first_ = true;
   }
 };
@@ -0,0 +1,199 @@
+/// @file      control/relay_tuner.hpp
+/// @author    Hiroshi Mikuriya
+/// @copyright Copyright© 2022 Hiroshi Mikuriya
+///
+/// DO NOT USE THIS SOFTWARE WITHOUT THE SOFTWARE LICENSE AGREEMENT.
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+namespace mik
+{
+class RelayTuner;
+}
+
+/// @brief リレーフィードバックでPIDの係数を求めるクラス
+/// @note 偏差の符号で出力を ±振幅 に切り替えて制御対象を持続振動させ、振動の振幅 a と周期 T から
+///       限界ゲイン Ku = πdr / (2a) と限界周期 Tu = T / r を求める（d: リレー振幅、h: ヒステリシス）。
+///       πd / (2a) は、むだ時間のある一次遅れ系で振動波形が三角波に近いことを踏まえた値で、
+///       正弦波を仮定した 4d / (πa) より限界ゲインに近い。r = (π/2) / (π/2 - asin(h/a)) はヒステリシスで
+///       切り替えが遅れる分の位相の補正で、h = 0 なら 1。（test/relay_tuner_test.cpp で解析解と比べている）
+///       目標値が0以外でも振動が上下対称になるように、出力のバイアスを周期ごとに補正する。
+///       係数は Tyreus-Luyben 則（Kp = Ku / 2.2、Ti = 2.2Tu、Td = Tu / 6.3）で求める。
+///       Ziegler-Nichols 則より控えめで、内側に電流ループを持つ速度ループでも行き過ぎが小さい。
+class mik::RelayTuner
+{
+  RelayTuner() = delete; ///< デフォルトコンストラクタ削除
+
+public:
+  /// @brief 状態
+  enum State
+  {
+    RUNNING = 0, ///< 測定中
+    DONE,        ///< 測定完了
+    FAILED,      ///< 時間内に振動しなかった
+  };
+
+private:
+  static constexpr uint32_t SKIP_CYCLES = 2; ///< 立ち上がりの過渡状態として捨てる周期数
+  static constexpr float RAMP_TIME = 0.5f;   ///< 最初に切り替わるまで、バイアスをリレー振幅分だけ動かす時間（s）
+
+  float dt_;          ///< 呼び出し周期（s）
+  float amplitude_;   ///< リレー振幅
+  float hysteresis_;  ///< 切り替えのヒステリシス
+  uint32_t cycles_;   ///< 平均する周期数
+  uint32_t timeout_;  ///< 打ち切るまでの呼び出し回数
+  State state_;       ///< 状態
+  bool high_;         ///< 出力が正側か
+  bool started_;      ///< 一度でも切り替わったか
+  float bias_;        ///< 出力のバイアス
+  uint32_t count_;    ///< 呼び出し回数
+  uint32_t rise_;     ///< 前回正側に切り替えた時の呼び出し回数
+  uint32_t fall_;     ///< 前回負側に切り替えた時の呼び出し回数
+  uint32_t cycle_;    ///< 振動した周期数
+  float max_;         ///< 今の周期のフィードバック値の最大値
+  float min_;         ///< 今の周期のフィードバック値の最小値
+  float sumPeriod_;   ///< 周期の合計（呼び出し回数）
+  float sumAmp_;      ///< 振幅の合計
+  float ku_;          ///< 限界ゲイン
+  float tu_;          ///< 限界周期（s）
+
+  /// @brief 正側に切り替えた時に１周期分を集計する
+  void onRise()
+  {
+    if (0 < rise_ && rise_ < fall_)
+    {
+      uint32_t period = count_ - rise_;
+      uint32_t highTime = fall_ - rise_;
+      // 正側が長いのは押し上げる力が足りないから。正側と負側の時間が等しくなるようにバイアスを寄せる
+      bias_ += amplitude_ * (2.0f * highTime - period) / period / 2;
+      if (SKIP_CYCLES < ++cycle_)
+      {
+        sumPeriod_ += period;
+        sumAmp_ += (max_ - min_) / 2;
+      }
+    }
+    rise_ = count_;
+    max_ = -HUGE_VALF;
+    min_ = HUGE_VALF;
+    if (SKIP_CYCLES + cycles_ <= cycle_)
+    {
+      float const halfPi = static_cast<float>(M_PI) / 2;
+      float a = sumAmp_ / cycles_;
+      if (hysteresis_ < a)
+      {
+        float r = halfPi / (halfPi - std::asin(hysteresis_ / a));
+        tu_ = sumPeriod_ / cycles_ * dt_ / r;
+        ku_ = halfPi * amplitude_ * r / a;
+      }
+      state_ = 0 < ku_ ? DONE : FAILED;
+    }
+  }
+
+public:
+  /// @brief コンストラクタ
+  /// @param [in] dt 呼び出し周期（s）
+  /// @param [in] amplitude リレー振幅（出力の単位）
+  /// @param [in] hysteresis 切り替えのヒステリシス（フィードバック値の単位）。ノイズで切り替わらない程度にする
+  /// @param [in] cycles 平均する周期数
+  /// @param [in] timeout 打ち切るまでの時間（s）
+  explicit RelayTuner(float dt, float amplitude, float hysteresis, uint32_t cycles, float timeout) //
+      : dt_(dt),                                                                                 //
+        amplitude_(amplitude),                                                                   //
+        hysteresis_(hysteresis),                                                                 //
+        cycles_(cycles),                                                                         //
+        timeout_(static_cast<uint32_t>(timeout / dt))                                            //
+  {
+    reset();
+  }
+  /// @brief デストラクタ
+  virtual ~RelayTuner() {}
+  /// @brief 測定を始め直す
+  void reset()
+  {
+    state_ = RUNNING;
+    high_ = true;
+    started_ = false;
+    bias_ = 0;
+    count_ = 0;
+    rise_ = 0;
+    fall_ = 0;
+    cycle_ = 0;
+    max_ = -HUGE_VALF;
+    min_ = HUGE_VALF;
+    sumPeriod_ = 0;
+    sumAmp_ = 0;
+    ku_ = 0;
+    tu_ = 0;
+  }
+  /// @brief 出力値を計算する
+  /// @param [in] target 目標値
+  /// @param [in] fb フィードバック値
+  /// @return 出力値（測定を終えたら0）
+  float step(float target, float fb)
+  {
+    if (state_ != RUNNING)
+    {
+      return 0;
+    }
+    ++count_;
+    max_ = std::fmax(max_, fb);
+    min_ = std::fmin(min_, fb);
+    float e = target - fb;
+    if (count_ == 1)
+    {
+      high_ = 0 < e; // 最初は目標値に近づく向きに出す
+    }
+    else if (high_ && e < -hysteresis_)
+    {
+      high_ = false;
+      started_ = true;
+      fall_ = count_;
+    }
+    else if (!high_ && hysteresis_ < e)
+    {
+      high_ = true;
+      started_ = true;
+      onRise();
+    }
+    if (!started_)
+    {
+      // リレー振幅だけでは目標値に届かない場合（摩擦や目標値が大きい）に備えて、届くまでバイアスを動かす
+      bias_ += (high_ ? amplitude_ : -amplitude_) * dt_ / RAMP_TIME;
+    }
+    if (state_ == RUNNING && timeout_ <= count_)
+    {
+      state_ = FAILED;
+    }
+    if (state_ != RUNNING)
+    {
+      return 0;
+    }
+    return bias_ + (high_ ? amplitude_ : -amplitude_);
+  }
+  /// @brief 状態を取得する @return 状態
+  State state() const { return state_; }
+  /// @brief 限界ゲインを取得する @return 限界ゲイン（測定完了前は0）
+  float ultimateGain() const { return ku_; }
+  /// @brief 限界周期を取得する @return 限界周期（s、測定完了前は0）
+  float ultimatePeriod() const { return tu_; }
+  /// @brief PID の係数を求める
+  /// @param [out] kp Kp
+  /// @param [out] ki Ki（1/s。呼び出し周期を掛けて使う）
+  /// @param [out] kd Kd（s。呼び出し周期で割って使う）
+  /// @retval true 求めた
+  /// @retval false 測定が完了していない
+  bool suggest(float &kp, float &ki, float &kd) const
+  {
+    if (state_ != DONE)
+    {
+      return false;
+    }
+    kp = ku_ / 2.2f;
+    ki = kp / (2.2f * tu_);
+    kd = kp * tu_ / 6.3f;
+    return true;
+  }
+};
@@ -0,0 +1,78 @@
+/// @file      control/sample_history.hpp
+/// @author    Hiroshi Mikuriya
+/// @copyright Copyright© 2022 Hiroshi Mikuriya
+///
+/// DO NOT USE THIS SOFTWARE WITHOUT THE SOFTWARE LICENSE AGREEMENT.
+
+#pragma once
+
+#include <cstdint>
+
+namespace mik
+{
+template <uint32_t Channels, uint32_t Size>
+class SampleHistory;
+}
+
+/// @brief 時刻付きのサンプルを直近 Size 個だけ保持するリングバッファ
+/// @tparam Channels チャネル数（エンコーダの数）
+/// @tparam Size 保持するサンプル数（2のべき乗）
+/// @note 全チャネルを同じ時刻にサンプルした組を１つとして、時刻を１つだけ持つ。
+///       値はチャネルごとに連続した配列に持つので、１つのチャネルの履歴を読む時はメモリを順に読むだけで済む。
+template <uint32_t Channels, uint32_t Size>
+class mik::SampleHistory
+{
+  static_assert(0 < Size && (Size & (Size - 1)) == 0, "Size must be a power of 2");
+
+  SampleHistory(SampleHistory const &) = delete;            ///< コピーコンストラクタ削除
+  SampleHistory &operator=(SampleHistory const &) = delete; ///< 代入演算子削除
+
+  static constexpr uint32_t MASK = Size - 1; ///< 位置のマスク
+
+  int32_t value_[Channels][Size]; ///< チャネルごとの値
+  uint32_t stamp_[Size];          ///< サンプルの時刻
+  uint32_t head_;                 ///< 次に書き込む位置（書き込んだサンプルの通し番号）
+
+public:
+  /// @brief コンストラクタ
+  SampleHistory() : value_(), stamp_(), head_(0) {}
+  /// @brief デストラクタ
+  virtual ~SampleHistory() {}
+  /// @brief サンプルを１組追加する（一杯なら最も古い組を捨てる）
+  /// @param [in] stamp サンプルの時刻
+  /// @param [in] values チャネル順の値
+  void push(uint32_t stamp, int32_t const (&values)[Channels])
+  {
+    uint32_t i = head_ & MASK;
+    for (uint32_t ch = 0; ch < Channels; ++ch)
+    {
+      value_[ch][i] = values[ch];
+    }
+    stamp_[i] = stamp;
+    ++head_;
+  }
+  /// @brief チャネルの全ての値をずらす
+  /// @param [in] ch チャネル
+  /// @param [in] delta ずらす量
+  /// @note エンコーダ値を0に戻した時に、履歴を新しい原点に合わせる（差分から求める速度等は変わらない）
+  void shift(uint32_t ch, int32_t delta)
+  {
+    for (auto &v : value_[ch])
+    {
+      v += delta;
+    }
+  }
+  /// @brief 保持しているサンプル数を取得する @return サンプル数
+  uint32_t size() const { return head_ < Size ? head_ : Size; }
+  /// @brief これまでに追加したサンプル数を取得する @return サンプル数（一周すると0に戻る）
+  uint32_t count() const { return head_; }
+  /// @brief 値を取得する
+  /// @param [in] ch チャネル
+  /// @param [in] age 最新から数えた位置（0が最新、size() 未満）
+  /// @return 値
+  int32_t value(uint32_t ch, uint32_t age) const { return value_[ch][(head_ - 1 - age) & MASK]; }
+  /// @brief 時刻を取得する
+  /// @param [in] age 最新から数えた位置（0が最新、size() 未満）
+  /// @return 時刻
+  uint32_t stamp(uint32_t age) const { return stamp_[(head_ - 1 - age) & MASK]; }
+};
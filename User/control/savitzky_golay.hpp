@@ -0,0 +1,159 @@
+/// @file      control/savitzky_golay.hpp
+/// @author    Hiroshi Mikuriya
+/// @copyright Copyright© 2022 Hiroshi Mikuriya
+///
+/// DO NOT USE THIS SOFTWARE WITHOUT THE SOFTWARE LICENSE AGREEMENT.
+
+#pragma once
+
+#include "sample_history.hpp"
+#include <cmath>
+#include <cstdint>
+
+namespace mik
+{
+struct Motion;
+template <uint32_t Window>
+class SavitzkyGolay;
+} // namespace mik
+
+/// @brief 位置とその微分の推定値
+struct mik::Motion
+{
+  float position;     ///< 位置
+  float velocity;     ///< 速度（/s）
+  float acceleration; ///< 加速度（/s^2）
+};
+
+/// @brief Savitzky-Golay 法で位置・速度・加速度を推定するクラス
+/// @tparam Window 当てはめに使うサンプル数（3以上）
+/// @note 直近 Window 個のサンプルに２次式を最小二乗で当てはめ、最新のサンプルの時刻での値と微分を求める。
+///       係数はサンプル数だけで決まるのでコンストラクタで一度だけ計算し、推定は積和だけで済ませる。
+///       サンプル間隔は等間隔とみなし、窓の両端の時刻の差から実際の間隔を求めて微分を換算する。
+///       窓の中央ではなく端で評価するので遅れは無いが、同じ窓幅の中央評価より雑音は大きい。
+///       1kHz でサンプルした１カウント単位のエンコーダ値に Window = 128 で当てはめると、誤差は
+///       速度で数カウント/s（rms 1〜4、最大約10）、等加速度運動中の加速度で rms 20〜60 カウント/s^2 程度
+///       （加速度が大きいほど大きい）。100Hz で Window = 12 なら、速度で rms 1〜11（最大約25）、
+///       加速度で rms 80〜190 カウント/s^2 程度（test/savitzky_golay_test.cpp）。
+template <uint32_t Window>
+class mik::SavitzkyGolay
+{
+  static_assert(3 <= Window, "Window must be 3 or more for a quadratic fit");
+
+  SavitzkyGolay(SavitzkyGolay const &) = delete;            ///< コピーコンストラクタ削除
+  SavitzkyGolay &operator=(SavitzkyGolay const &) = delete; ///< 代入演算子削除
+
+  static constexpr uint32_t ORDER = 2; ///< 当てはめる多項式の次数。エンコーダの量子化雑音では３階微分は使える精度にならない
+
+  float coef_[ORDER + 1][Window]; ///< 微分の階数・最新から数えた位置ごとの係数（窓の時間幅を1とした値）
+
+public:
+  /// @brief コンストラクタ
+  SavitzkyGolay() : coef_()
+  {
+    constexpr uint32_t N = ORDER + 1;
+    // 最新を0、最古を-1とした時刻 s で、正規方程式 (AᵀA) a = Aᵀx を解く係数行列 (AᵀA)⁻¹Aᵀ を求める
+    double m[N][2 * N] = {};
+    for (uint32_t age = 0; age < Window; ++age)
+    {
+      double s = -static_cast<double>(age) / (Window - 1);
+      for (uint32_t j = 0; j < N; ++j)
+      {
+        for (uint32_t l = 0; l < N; ++l)
+        {
+          m[j][l] += std::pow(s, j + l);
+        }
+      }
+    }
+    for (uint32_t j = 0; j < N; ++j)
+    {
+      m[j][N + j] = 1;
+    }
+    for (uint32_t col = 0; col < N; ++col)
+    {
+      uint32_t pivot = col;
+      for (uint32_t r = col + 1; r < N; ++r)
+      {
+        pivot = std::fabs(m[pivot][col]) < std::fabs(m[r][col]) ? r : pivot;
+      }
+      for (uint32_t c = 0; c < 2 * N; ++c)
+      {
+        double t = m[col][c];
+        m[col][c] = m[pivot][c];
+        m[pivot][c] = t;
+      }
+      double d = m[col][col];
+      for (uint32_t c = 0; c < 2 * N; ++c)
+      {
+        m[col][c] /= d;
+      }
+      for (uint32_t r = 0; r < N; ++r)
+      {
+        if (r == col)
+        {
+          continue;
+        }
+        double f = m[r][col];
+        for (uint32_t c = 0; c < 2 * N; ++c)
+        {
+          m[r][c] -= f * m[col][c];
+        }
+      }
+    }
+    double factorial = 1;
+    for (uint32_t d = 0; d < N; ++d)
+    {
+      factorial *= d ? d : 1; // d 階微分は d! × a_d
+      for (uint32_t age = 0; age < Window; ++age)
+      {
+        double s = -static_cast<double>(age) / (Window - 1);
+        double g = 0;
+        for (uint32_t l = 0; l < N; ++l)
+        {
+          g += m[d][N + l] * std::pow(s, l);
+        }
+        coef_[d][age] = static_cast<float>(factorial * g);
+      }
+    }
+  }
+  /// @brief デストラクタ
+  virtual ~SavitzkyGolay() {}
+  /// @brief 最新のサンプルの時刻での位置と微分を推定する
+  /// @tparam Channels 履歴のチャネル数
+  /// @tparam Size 履歴のサンプル数
+  /// @param [in] history サンプルの履歴
+  /// @param [in] ch チャネル
+  /// @param [in] clockHz 履歴の時刻のクロック周波数（Hz）
+  /// @param [out] m 推定値
+  /// @retval true 推定した
+  /// @retval false サンプルが Window 個に満たない、または時刻が進んでいない
+  template <uint32_t Channels, uint32_t Size>
+  bool estimate(SampleHistory<Channels, Size> const &history, uint32_t ch, float clockHz, Motion &m) const
+  {
+    static_assert(Window <= Size, "Window must not exceed the history size");
+    if (history.size() < Window)
+    {
+      return false;
+    }
+    uint32_t ticks = history.stamp(0) - history.stamp(Window - 1);
+    if (ticks == 0)
+    {
+      return false;
+    }
+    float span = ticks / clockHz;
+    int32_t origin = history.value(ch, 0); // 大きな値でも float の桁が落ちないように最新値からの差で計算する
+    float a[ORDER + 1] = {};
+    for (uint32_t age = 0; age < Window; ++age)
+    {
+      float x = static_cast<float>(history.value(ch, age) - origin);
+      for (uint32_t d = 0; d <= ORDER; ++d)
+      {
+        a[d] += coef_[d][age] * x;
+      }
+    }
+    m.position = origin + a[0];
+    m.velocity = a[1] / span;
+    m.acceleration = a[2] / (span * span);
+    return true;
+  }
+};
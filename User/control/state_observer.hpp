@@ -0,0 +1,96 @@
+/// @file      control/state_observer.hpp
+/// @author    Hiroshi Mikuriya
+/// @copyright Copyright© 2022 Hiroshi Mikuriya
+///
+/// DO NOT USE THIS SOFTWARE WITHOUT THE SOFTWARE LICENSE AGREEMENT.
+
+#pragma once
+
+#include <cstdint>
+
+namespace mik
+{
+class StateObserver;
+}
+
+/// @brief エンコーダ値から位置・速度・加速度を推定する状態観測器（α-β-γ フィルタ）
+/// @note 等加速度モデルで１周期先を予測し、エンコーダ値との差（残差）に一定のゲインを掛けて状態を補正する。
+///       ゲインが一定の α-β-γ フィルタは、定常状態のカルマンフィルタと同じ形になる。
+///       ゲインは減衰率 θ だけで決まる fading memory 型（α = 1 - θ³、β = 1.5(1 - θ)²(1 + θ)、γ = 0.5(1 - θ)³）にしており、
+///       過去の残差の重みが１周期ごとに θ 倍になる。移動平均と違い、等加速度で動いている間は遅れが残らない。
+///       入力ゲインを設定すると、電流から求めた加速度を予測に加え、γ はモデルで説明できない外乱加速度だけを推定する。
+///       呼び出し間隔はサンプルの時刻の差で与えるので、割り込みの遅れでサンプル間隔が揺らいでも速度・加速度は偏らない。
+///       位置とは別に速度の測定値（M/T法の速度等）があれば、correctVelocity で速度の推定値を寄せる。
+class mik::StateObserver
+{
+  StateObserver() = delete; ///< デフォルトコンストラクタ削除
+
+  float alpha_;        ///< 位置のゲイン
+  float beta_;         ///< 速度のゲイン
+  float gamma_;        ///< 加速度のゲイン
+  float inputGain_;    ///< 入力１当たりの加速度（/s^2）。0なら入力を使わない
+  float speedGain_;    ///< 速度の測定値に寄せる比率。0なら速度の測定値を使わない
+  float position_;     ///< 位置の推定値
+  float velocity_;     ///< 速度の推定値（/s）
+  float disturbance_;  ///< 入力で説明できない加速度の推定値（/s^2）
+  float acceleration_; ///< 加速度の推定値（/s^2）
+
+public:
+  /// @brief コンストラクタ
+  /// @param [in] theta 減衰率（0 〜 1）。1に近いほど雑音を抑えるが、加速度の変化への追従が遅い
+  explicit StateObserver(float theta)                           //
+      : alpha_(1 - theta * theta * theta),                      //
+        beta_(1.5f * (1 - theta) * (1 - theta) * (1 + theta)),  //
+        gamma_(0.5f * (1 - theta) * (1 - theta) * (1 - theta)), //
+        inputGain_(0),                                          //
+        speedGain_(0),                                          //
+        position_(0),                                           //
+        velocity_(0),                                           //
+        disturbance_(0),                                        //
+        acceleration_(0)                                        //
+  {
+  }
+  /// @brief デストラクタ
+  virtual ~StateObserver() {}
+  /// @brief 入力ゲインを設定する
+  /// @param [in] gain 入力１当たりの加速度（/s^2）。電流を入力にするなら、トルク定数 / 慣性モーメント をカウント単位にした値
+  void setInputGain(float gain) { inputGain_ = gain; }
+  /// @brief 速度の測定値に寄せる比率を設定する
+  /// @param [in] gain 比率（0 〜 1）。測定値の雑音が小さいほど大きくできる
+  void setSpeedGain(float gain) { speedGain_ = gain; }
+  /// @brief 指定した状態から推定し直す
+  /// @param [in] position 位置
+  /// @param [in] velocity 速度（/s）
+  void reset(float position, float velocity)
+  {
+    position_ = position;
+    velocity_ = velocity;
+    disturbance_ = 0;
+    acceleration_ = 0;
+  }
+  /// @brief 測定値を１つ加えて状態を更新する
+  /// @param [in] measured 位置の測定値（エンコーダ値）
+  /// @param [in] dt 前回の測定値からの時間（s、0より大きいこと）
+  /// @param [in] input 入力（電流等）。入力ゲインが0なら使わない
+  void update(float measured, float dt, float input = 0)
+  {
+    float acc = disturbance_ + inputGain_ * input;
+    float position = position_ + (velocity_ + acc * dt / 2) * dt;
+    float velocity = velocity_ + acc * dt;
+    float r = measured - position;
+    position_ = position + alpha_ * r;
+    velocity_ = velocity + beta_ * r / dt;
+    disturbance_ += 2 * gamma_ * r / (dt * dt);
+    acceleration_ = disturbance_ + inputGain_ * input;
+  }
+  /// @brief 速度の測定値で速度の推定値を補正する
+  /// @param [in] measured 速度の測定値（/s）
+  /// @note update の後に呼ぶ。速度比率が0なら何もしない
+  void correctVelocity(float measured) { velocity_ += speedGain_ * (measured - velocity_); }
+  /// @brief 位置の推定値を取得する @return 位置
+  float position() const { return position_; }
+  /// @brief 速度の推定値を取得する @return 速度（/s）
+  float velocity() const { return velocity_; }
+  /// @brief 加速度の推定値を取得する @return 加速度（/s^2）
+  float acceleration() const { return acceleration_; }
+};
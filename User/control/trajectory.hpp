@@ -0,0 +1,130 @@
+/// @file      control/trajectory.hpp
+/// @author    Hiroshi Mikuriya
+/// @copyright Copyright© 2022 Hiroshi Mikuriya
+///
+/// DO NOT USE THIS SOFTWARE WITHOUT THE SOFTWARE LICENSE AGREEMENT.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace mik
+{
+class Trajectory;
+}
+
+/// @brief 速度・加速度・加加速度の制限付きで目標位置までの軌道を生成するクラス
+/// @note 制御周期ごとに update を呼び出し、位置・速度の指令値を１点ずつ生成する。
+///       毎回その時点の状態から停止距離を計算し直すので、移動中に目標位置が変わってもそのまま追従する。
+///       加加速度を制限する場合は、台形速度を幅 A/J の移動平均に通してS字速度にする。
+///       移動平均は速度の面積を保つので、到達位置は台形速度と一致し、行き過ぎない（A/2J 秒遅れる）。
+///       速度・加速度の上限に同じ倍率を掛けると、移動距離が同じ倍率の移動と全く同じ時間で動く（setScale）。
+class mik::Trajectory
+{
+  Trajectory() = delete; ///< デフォルトコンストラクタ削除
+
+  static constexpr uint32_t MAX_WINDOW = 128; ///< 移動平均の最大サンプル数（超える場合は加加速度の制限が緩くなる）
+
+  float dt_;                 ///< 制御周期（s）
+  float maxVel_;             ///< 最大速度（/s）
+  float maxAcc_;             ///< 最大加速度（/s^2）
+  float scale_;              ///< 最大速度・最大加速度に掛ける倍率
+  float rawPosition_;        ///< 台形速度の位置
+  float rawVelocity_;        ///< 台形速度の速度（/s）
+  float position_;           ///< 位置指令値
+  float velocity_;           ///< 速度指令値（/s）
+  float accel_;              ///< 加速度指令値（/s^2）
+  float window_[MAX_WINDOW]; ///< 移動平均する台形速度の履歴
+  float sum_;                ///< window_ の合計
+  uint32_t size_;            ///< 移動平均のサンプル数（1なら台形速度のまま）
+  uint32_t index_;           ///< 次に書き込む履歴の位置
+  uint32_t idle_;            ///< 台形速度が停止してからのサンプル数
+
+  /// @brief 台形速度を１周期分進める
+  /// @param [in] target 目標位置
+  void step(float target)
+  {
+    float e = target - rawPosition_;
+    float maxVel = maxVel_ * scale_;
+    float maxAcc = maxAcc_ * scale_;
+    if (std::abs(e) <= std::abs(rawVelocity_) * dt_ && std::abs(rawVelocity_) <= maxAcc * dt_)
+    {
+      rawPosition_ = target; // 1周期で届き、かつ1周期で止まれるなら目標位置で止める
+      rawVelocity_ = 0;
+      return;
+    }
+    float vel = std::min(std::sqrt(2 * maxAcc * std::abs(e)), maxVel); // 残り距離で止まれる速度 v^2 / 2A = d
+    float acc = ((e < 0 ? -vel : vel) - rawVelocity_) / dt_;
+    acc = std::max(-maxAcc, std::min(acc, maxAcc));
+    rawVelocity_ = std::max(-maxVel, std::min(rawVelocity_ + acc * dt_, maxVel));
+    rawPosition_ += rawVelocity_ * dt_;
+  }
+
+public:
+  /// @brief コンストラクタ
+  /// @param [in] dt 制御周期（s）
+  /// @param [in] maxVel 最大速度（/s）
+  /// @param [in] maxAcc 最大加速度（/s^2）
+  /// @param [in] maxJerk 最大加加速度（/s^3）。0なら台形速度
+  explicit Trajectory(float dt, float maxVel, float maxAcc, float maxJerk) //
+      : dt_(dt), maxVel_(maxVel), maxAcc_(maxAcc), scale_(1), size_(1)
+  {
+    if (0 < maxJerk)
+    {
+      float n = maxAcc / (maxJerk * dt) + 0.5f;
+      size_ = n < 1 ? 1 : (MAX_WINDOW < n ? MAX_WINDOW : static_cast<uint32_t>(n));
+    }
+    reset(0);
+  }
+  /// @brief デストラクタ
+  virtual ~Trajectory() {}
+  /// @brief 指定した状態から始め直す
+  /// @param [in] position 現在位置
+  /// @param [in] velocity 現在速度（/s）。外部の指令値から軌道生成に切り替える場合に、速度を引き継ぐ
+  void reset(float position, float velocity = 0)
+  {
+    rawPosition_ = position;
+    rawVelocity_ = velocity;
+    position_ = position;
+    velocity_ = velocity;
+    accel_ = 0;
+    std::fill(window_, window_ + MAX_WINDOW, velocity);
+    sum_ = velocity * size_;
+    index_ = 0;
+    idle_ = 0;
+  }
+  /// @brief 最大速度・最大加速度に倍率を掛ける
+  /// @param [in] scale 倍率（0 〜 1）
+  /// @note 複数軸を同時に動かし始めて同時に止めたい場合に、最も遠い軸との移動距離の比を設定する
+  void setScale(float scale) { scale_ = scale; }
+  /// @brief 指令値を１周期分進める
+  /// @param [in] target 目標位置
+  void update(float target)
+  {
+    step(target);
+    sum_ += rawVelocity_ - window_[index_];
+    window_[index_] = rawVelocity_;
+    index_ = (index_ + 1) % size_;
+    float vel = sum_ / size_;
+    accel_ = (vel - velocity_) / dt_;
+    velocity_ = vel;
+    position_ += velocity_ * dt_;
+    idle_ = rawVelocity_ == 0 ? idle_ + 1 : 0;
+    if (size_ <= idle_)
+    {
+      // 移動平均の履歴が全て0になったら、積算誤差を捨てて台形速度の位置に揃える
+      position_ = rawPosition_;
+      velocity_ = 0;
+      accel_ = 0;
+      sum_ = 0;
+    }
+  }
+  /// @brief 位置指令値を取得する @return 位置指令値
+  float position() const { return position_; }
+  /// @brief 速度指令値を取得する @return 速度指令値（/s）
+  float velocity() const { return velocity_; }
+  /// @brief 加速度指令値を取得する @return 加速度指令値（/s^2）
+  float acceleration() const { return accel_; }
+};
@@ -6,6 +6,7 @@
 
 #include "ssd1306.h"
 #include "constants.h"
+#include "control/motor.h"
 #include "fonts.h"
 #include <cmsis_os.h>
 #include <cstdio>  // to use 'memset'
@@ -15,10 +16,13 @@ using namespace mik;
 
 namespace
 {
-constexpr uint8_t WIDTH = 128;                  ///< 横ピクセル数
-constexpr uint8_t NUM_PAGE = 8;                 ///< ページ数
-constexpr uint8_t HEIGHT = NUM_PAGE * 8;        ///< 縦ピクセル数
-constexpr uint32_t BUF_SIZE = WIDTH * NUM_PAGE; ///< 画面の全ピクセルデータをバッファするのに必要なサイズ
+constexpr uint8_t WIDTH = 128;                                     ///< 横ピクセル数
+constexpr uint8_t NUM_PAGE = 8;                                    ///< ページ数
+constexpr uint8_t HEIGHT = NUM_PAGE * 8;                           ///< 縦ピクセル数
+constexpr uint32_t BUF_SIZE = WIDTH * NUM_PAGE;                    ///< 画面の全ピクセルデータをバッファするのに必要なサイズ
+constexpr uint32_t ROWS = 2;                                       ///< １画面に表示するモータ数
+constexpr uint32_t SCREEN_COUNT = (MOTOR_COUNT + ROWS - 1) / ROWS; ///< 全モータを表示するのに必要な画面数
+constexpr uint32_t SCREEN_FRAMES = 20;                             ///< 次の画面に切り替えるまでの update の呼び出し回数
 
 constexpr uint8_t SSD1306_CONFIG_MUX_RATIO_CMD = 0xA8;
 constexpr uint8_t SSD1306_CONFIG_MUX_RATIO_A = 0x3F;
@@ -119,6 +123,8 @@ inline char const *const modeText(mik::MotorMode m)
     return "VELOCITY";
   case mik::POSITION:
     return "POSITION";
+  case mik::AUTOTUNE:
+    return "AUTOTUNE";
   default:
     return "NONE";
   }
@@ -212,22 +218,35 @@ I2C::Result SSD1306::sendBufferToDevice()
   return res;
 }
 
-void SSD1306::writeBuffer(Motor const &motor, uint32_t i)
+void SSD1306::writeBuffer(msg::MotorStatus const &status, uint32_t row)
 {
-  uint8_t y = static_cast<uint8_t>(HEIGHT / 2 * i);
+  uint8_t y = static_cast<uint8_t>(HEIGHT / ROWS * row);
   char c[24] = {0};
   uint8_t *buf = buffer_ + 1;
-  drawString(modeText(motor.mode()), Font_7x10, false, 0, y, buf);
-  snprintf(c, sizeof(c), "%5.1fmA %.1fV", motor.getCurrent(), motor.getBusVoltage());
+  auto mode = static_cast<MotorMode>(status.mode);
+  drawString(modeText(mode), Font_7x10, false, 0, y, buf);
+  if (mode == AUTOTUNE && status.tuner == RelayTuner::DONE)
+  {
+    snprintf(c, sizeof(c), "Ku%.3g Tu%.3gs", status.ultimateGain, status.ultimatePeriod);
+  }
+  else if (mode == AUTOTUNE && status.tuner == RelayTuner::FAILED)
+  {
+    snprintf(c, sizeof(c), "TUNE FAILED");
+  }
+  else
+  {
+    snprintf(c, sizeof(c), "%5.1fmA %.1fV", status.current, status.busVoltage);
+  }
   drawString(c, Font_7x10, false, 0, y + 11, buf);
-  snprintf(c, sizeof(c), "E:%ld V:%ld R:%ld", motor.encoder().get(), motor.getVelocity(), motor.nob().get());
+  snprintf(c, sizeof(c), "E:%ld V:%ld R:%ld", status.encoder, status.velocity, status.nob);
   drawString(c, Font_7x10, false, 0, y + 22, buf);
 }
 
-SSD1306::SSD1306(I2C *i2c, uint8_t slaveAddr)                 //
-    : i2c_(i2c),                                              //
-      slaveAddr_(slaveAddr),                                  //
-      buffer_(static_cast<uint8_t *>(pvPortMalloc(BUF_SIZE))) //
+SSD1306::SSD1306(I2C *i2c, uint8_t slaveAddr)                  //
+    : i2c_(i2c),                                               //
+      slaveAddr_(slaveAddr),                                   //
+      buffer_(static_cast<uint8_t *>(pvPortMalloc(BUF_SIZE))), //
+      frame_(0)                                                //
 {
   memset(buffer_, 0, BUF_SIZE);
 }
@@ -256,14 +275,15 @@ I2C::Result SSD1306::showText(const char *txt)
   return sendBufferToDevice();
 }
 
-I2C::Result SSD1306::update(Application const *app)
+I2C::Result SSD1306::update(msg::MotorStatus const *status)
 {
   memset(buffer_, 0, BUF_SIZE);
-  if (app)
+  if (status)
   {
-    for (uint32_t i = 0; i < MOTOR_COUNT; ++i)
+    uint32_t top = frame_++ / SCREEN_FRAMES % SCREEN_COUNT * ROWS;
+    for (uint32_t row = 0; row < ROWS && top + row < MOTOR_COUNT; ++row)
     {
-      writeBuffer(app->motor(i), i);
+      writeBuffer(status[top + row], row);
     }
   }
   return sendBufferToDevice();
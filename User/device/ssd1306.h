@@ -6,7 +6,7 @@
 
 #pragma once
 
-#include "application.h"
+#include "message/msgdef.h"
 #include "peripheral/i2c.h"
 
 namespace mik
@@ -29,14 +29,15 @@ class mik::SSD1306
   I2C *i2c_;          ///< I2C通信クラス
   uint8_t slaveAddr_; ///< スレーブアドレス
   uint8_t *buffer_;   ///< 表示用バッファ
+  uint32_t frame_;    ///< update の呼び出し回数（表示するモータの切り替えに使う）
 
   /// @brief 全ページ分のバッファをOLEDに書き込む
   /// @return I2C通信結果
   I2C::Result sendBufferToDevice();
   /// @brief 画面表示を更新する
-  /// @param [in] motor モータ
-  /// @param [in] i モータID
-  void writeBuffer(Motor const &motor, uint32_t i);
+  /// @param [in] status モータ状態
+  /// @param [in] row 表示する行（0 or 1）
+  void writeBuffer(msg::MotorStatus const &status, uint32_t row);
 
 public:
   /// @brief コンストラクタ
@@ -59,7 +60,8 @@ public:
   /// @return I2C通信結果
   I2C::Result showText(const char *txt);
   /// @brief 画面表示を更新する
-  /// @param [in] app アプリケーション
+  /// @param [in] status モータID順のモータ状態（MOTOR_COUNT 個。0なら何も表示しない）
   /// @return I2C通信結果
-  I2C::Result update(Application const *app);
+  /// @note １画面に２モータずつ表示する。モータが３つ以上ある場合は一定回数ごとに次の２モータに切り替える。
+  I2C::Result update(msg::MotorStatus const *status);
 };
@@ -0,0 +1,146 @@
+/// @file      message/latency.cpp
+/// @author    Hiroshi Mikuriya
+/// @copyright Copyright© 2022 Hiroshi Mikuriya
+///
+/// DO NOT USE THIS SOFTWARE WITHOUT THE SOFTWARE LICENSE AGREEMENT.
+
+#include "latency.h"
+#include "common/cycle_counter.hpp"
+#include "common/interrupt_lock.hpp"
+#include "common/mutex.hpp"
+#include <atomic>
+
+#ifndef MAX_LATENCY_ID_COUNT
+#define MAX_LATENCY_ID_COUNT 16 ///< 遅延を計測できる最大メッセージ種別数
+#endif
+
+namespace
+{
+constexpr uint32_t CATEGORY_COUNT = 0x10000 >> msg::LATENCY_CATEGORY_SHIFT; ///< メッセージIDのカテゴリ数
+
+/// @brief 遅延の度数分布
+struct Histogram
+{
+  std::atomic<uint32_t> counts[LATENCY_BUCKET_COUNT]; ///< 区間ごとの度数
+  std::atomic<uint32_t> max;                          ///< 最大遅延（μs）
+};
+/// @brief メッセージ種別ごとの計測値
+struct Entry
+{
+  Histogram queued; ///< 送信から受信まで
+  Histogram held;   ///< 受信から解放まで
+};
+/// 計測値実態
+Entry s_entries[MAX_LATENCY_ID_COUNT] = {};
+/// メッセージIDごとに割り当てた計測値の番号 + 1（0なら未割り当て）
+std::atomic<uint8_t> s_slots[CATEGORY_COUNT * MAX_LATENCY_INDEX_COUNT] = {};
+/// 割り当てた計測値の数
+uint32_t s_used = 0;
+/// 計測値を割り当てる時の排他
+mik::InterruptLock s_lock;
+
+static_assert(MAX_LATENCY_ID_COUNT < 0x100, "slot number must fit in uint8_t");
+
+/// @brief メッセージ種別の計測値を取得する
+/// @param [in] type メッセージ種別
+/// @param [in] create 未割り当てなら空きを割り当てる
+/// @retval 0以外 計測値
+/// @retval 0 未割り当て、計測できない種別、または空きがない
+/// @note メッセージIDから割り当て表を直接引く。割り当ては種別ごとに最初の１回だけ割り込みを禁止して行う。
+Entry *entryOf(msg::ID type, bool create)
+{
+  uint32_t index = type & ((1U << msg::LATENCY_CATEGORY_SHIFT) - 1);
+  if (MAX_LATENCY_INDEX_COUNT <= index)
+  {
+    return 0;
+  }
+  std::atomic<uint8_t> &slot = s_slots[(type >> msg::LATENCY_CATEGORY_SHIFT) * MAX_LATENCY_INDEX_COUNT + index];
+  uint32_t n = slot.load(std::memory_order_acquire);
+  if (n == 0 && create)
+  {
+    mik::LockGuard<mik::InterruptLock> lock(s_lock);
+    n = slot.load(std::memory_order_relaxed);
+    if (n == 0 && s_used < MAX_LATENCY_ID_COUNT)
+    {
+      n = ++s_used;
+      slot.store(static_cast<uint8_t>(n), std::memory_order_release);
+    }
+  }
+  return n ? &s_entries[n - 1] : 0;
+}
+/// @brief 遅延を度数分布に加える
+/// @param [in] hist 度数分布
+/// @param [in] cycles 遅延サイクル数
+void add(Histogram &hist, uint32_t cycles)
+{
+  uint32_t us = mik::CycleCounter::toMicros(cycles);
+  uint32_t i = us ? 32 - __builtin_clz(us) : 0;
+  hist.counts[i < LATENCY_BUCKET_COUNT ? i : LATENCY_BUCKET_COUNT - 1].fetch_add(1, std::memory_order_relaxed);
+  uint32_t max = hist.max.load(std::memory_order_relaxed);
+  while (max < us && !hist.max.compare_exchange_weak(max, us, std::memory_order_relaxed))
+  {
+  }
+}
+/// @brief 度数分布を読み出す
+/// @param [in] hist 度数分布
+/// @param [out] counts 区間ごとの度数
+/// @return 最大遅延（μs）
+uint32_t read(Histogram const &hist, uint32_t *counts)
+{
+  for (uint32_t i = 0; i < LATENCY_BUCKET_COUNT; ++i)
+  {
+    counts[i] = hist.counts[i].load(std::memory_order_relaxed);
+  }
+  return hist.max.load(std::memory_order_relaxed);
+}
+/// @brief 度数分布を0に戻す
+/// @param [in] hist 度数分布
+void clear(Histogram &hist)
+{
+  for (auto &c : hist.counts)
+  {
+    c.store(0, std::memory_order_relaxed);
+  }
+  hist.max.store(0, std::memory_order_relaxed);
+}
+} // namespace
+
+osStatus msg::readLatency(ID type, LatencyHistogram &hist) noexcept
+{
+  Entry *e = entryOf(type, false);
+  if (e == 0)
+  {
+    return osErrorParameter;
+  }
+  hist.type = type;
+  hist.maxQueued = read(e->queued, hist.queued);
+  hist.maxHeld = read(e->held, hist.held);
+  return osOK;
+}
+
+void msg::resetLatency() noexcept
+{
+  for (auto &e : s_entries)
+  {
+    clear(e.queued);
+    clear(e.held);
+  }
+}
+
+void msg::recordQueued(ID type, uint32_t cycles) noexcept
+{
+  Entry *e = entryOf(type, true);
+  if (e)
+  {
+    add(e->queued, cycles);
+  }
+}
+
+void msg::recordHeld(ID type, uint32_t cycles) noexcept
+{
+  Entry *e = entryOf(type, true);
+  if (e)
+  {
+    add(e->held, cycles);
+  }
+}
@@ -0,0 +1,54 @@
+/// @file      message/latency.h
+/// @author    Hiroshi Mikuriya
+/// @copyright Copyright© 2022 Hiroshi Mikuriya
+///
+/// DO NOT USE THIS SOFTWARE WITHOUT THE SOFTWARE LICENSE AGREEMENT.
+
+#pragma once
+
+#include "msglib.h"
+
+#ifndef LATENCY_BUCKET_COUNT
+#define LATENCY_BUCKET_COUNT 16 ///< 遅延ヒストグラムの区間数
+#endif
+#ifndef MAX_LATENCY_INDEX_COUNT
+#define MAX_LATENCY_INDEX_COUNT 8 ///< カテゴリごとに遅延を計測できるメッセージ番号の数
+#endif
+
+namespace msg
+{
+struct LatencyHistogram;
+
+/// メッセージIDのカテゴリのビット位置（上位ビットがカテゴリ、下位ビットがカテゴリ内の番号）
+/// @note 計測値はメッセージIDから直接引くので、カテゴリ内の番号が MAX_LATENCY_INDEX_COUNT 以上の種別は計測しない
+constexpr uint32_t LATENCY_CATEGORY_SHIFT = 12;
+
+/// @brief メッセージ種別ごとの遅延ヒストグラムを取得する
+/// @param [in] type メッセージ種別
+/// @param [out] hist 遅延ヒストグラム
+/// @retval osOK 成功
+/// @retval osErrorParameter まだ１度も受信していない種別、または計測できない種別
+/// @note 計測中の値を１件ずつ読み出すので、区間同士の合計はわずかにずれる場合がある
+osStatus readLatency(ID type, LatencyHistogram &hist) noexcept;
+/// @brief 全種別の遅延ヒストグラムを0に戻す
+void resetLatency() noexcept;
+/// @brief 送信から受信までの遅延を記録する（msglib 内部で使用）
+/// @param [in] type メッセージ種別
+/// @param [in] cycles 遅延サイクル数
+void recordQueued(ID type, uint32_t cycles) noexcept;
+/// @brief 受信から解放までの遅延を記録する（msglib 内部で使用）
+/// @param [in] type メッセージ種別
+/// @param [in] cycles 遅延サイクル数
+void recordHeld(ID type, uint32_t cycles) noexcept;
+} // namespace msg
+
+/// @brief 遅延ヒストグラム
+/// @note 区間0は1μs未満、区間 i (i > 0) は 2^(i-1)μs 以上 2^i μs 未満。最後の区間はそれ以上の全てを含む。
+struct msg::LatencyHistogram
+{
+  ID type;                               ///< メッセージ種別
+  uint32_t queued[LATENCY_BUCKET_COUNT]; ///< 送信から受信までの遅延の度数
+  uint32_t held[LATENCY_BUCKET_COUNT];   ///< 受信から解放（処理完了）までの遅延の度数
+  uint32_t maxQueued;                    ///< 送信から受信までの最大遅延（μs）
+  uint32_t maxHeld;                      ///< 受信から解放までの最大遅延（μs）
+};
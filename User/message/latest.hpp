@@ -0,0 +1,73 @@
+/// @file      message/latest.hpp
+/// @author    Hiroshi Mikuriya
+/// @copyright Copyright© 2022 Hiroshi Mikuriya
+///
+/// DO NOT USE THIS SOFTWARE WITHOUT THE SOFTWARE LICENSE AGREEMENT.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace msg
+{
+template <typename T>
+class Latest;
+}
+
+/// @brief 最新値だけを保持するロックフリーのトリプルバッファ
+/// @tparam T 要素型
+/// @note 書き込み側・読み込み側ともに１つに限る。
+///       書き込み側は back に書いて publish、読み込み側は take で最新値を取得する。
+///       take で取得した要素は、次に take を呼ぶまで書き換えられない。
+template <typename T>
+class msg::Latest
+{
+  Latest(Latest const &) = delete;            ///< コピーコンストラクタ削除
+  Latest &operator=(Latest const &) = delete; ///< 代入演算子削除
+
+  static constexpr uint32_t FRESH = 4; ///< 中間バッファに未読の値がある
+  static constexpr uint32_t INDEX = 3; ///< 中間バッファ番号のマスク
+  T buf_[3];                           ///< バッファ
+  uint32_t seq_[3];                    ///< バッファに書き込んだ値の通し番号
+  std::atomic<uint32_t> state_;        ///< 中間バッファ番号 | FRESH
+  uint32_t back_;                      ///< 書き込み中のバッファ番号（書き込み側のみ使用）
+  uint32_t backSeq_;                   ///< 最後に書き込んだ通し番号（書き込み側のみ使用）
+  uint32_t front_;                     ///< 読み込み中のバッファ番号（読み込み側のみ使用）
+  uint32_t frontSeq_;                  ///< 最後に読み込んだ通し番号（読み込み側のみ使用）
+
+public:
+  /// @brief コンストラクタ
+  Latest() noexcept : buf_(), seq_(), state_(1), back_(0), backSeq_(0), front_(2), frontSeq_(0) {}
+  /// @brief デストラクタ
+  virtual ~Latest() {}
+  /// @brief 書き込み先の要素を取得する（書き込み側）
+  /// @return 書き込み先
+  T *back() noexcept { return &buf_[back_]; }
+  /// @brief back に書き込んだ値を最新値として公開する（書き込み側）
+  /// @retval true 読み込み側が前回の値を読み込み済みだった（読み込み側を起こす必要がある）
+  /// @retval false 未読の値を上書きした
+  bool publish() noexcept
+  {
+    seq_[back_] = ++backSeq_;
+    uint32_t old = state_.exchange(back_ | FRESH, std::memory_order_acq_rel);
+    back_ = old & INDEX;
+    return (old & FRESH) == 0;
+  }
+  /// @brief 未読の最新値を取得する（読み込み側）
+  /// @param [out] skipped 前回取得してから上書きされた値の数
+  /// @retval 0以外 最新値
+  /// @retval 0 未読の値なし
+  T *take(uint32_t &skipped) noexcept
+  {
+    if ((state_.load(std::memory_order_acquire) & FRESH) == 0)
+    {
+      return 0;
+    }
+    uint32_t old = state_.exchange(front_, std::memory_order_acq_rel);
+    front_ = old & INDEX;
+    skipped = seq_[front_] - frontSeq_ - 1;
+    frontSeq_ = seq_[front_];
+    return &buf_[front_];
+  }
+};
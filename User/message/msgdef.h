@@ -7,35 +7,58 @@
 #pragma once
 
 #include "constants.h"
+#include "control/motor_gains.h"
+#include "latency.h"
 #include "msglib.h"
+#include "registry.hpp"
 
 namespace msg
 {
 namespace cat
 {
 constexpr uint32_t SHIFT = 12;
+constexpr ID MASK = 0xF << SHIFT; ///< カテゴリ単位で購読する場合のマスク
 constexpr ID KEY = 1 << SHIFT;
 constexpr ID USB = 2 << SHIFT;
 constexpr ID PERIPH = 3 << SHIFT;
 constexpr ID SYSTEM = 4 << SHIFT;
+constexpr ID CTRL = 5 << SHIFT;
+static_assert(SHIFT == LATENCY_CATEGORY_SHIFT, "latency histograms are indexed by category");
 } // namespace cat
 
-constexpr ID KEY_MOTOR1_LEFT = 0 | cat::KEY;        ///< モータ1左キー押下
-constexpr ID KEY_MOTOR1_RIGHT = 1 | cat::KEY;       ///< モータ1右キー押下
-constexpr ID KEY_MOTOR2_LEFT = 2 | cat::KEY;        ///< モータ2左キー押下
-constexpr ID KEY_MOTOR2_RIGHT = 3 | cat::KEY;       ///< モータ2右キー押下
+constexpr ID KEY_MOTOR_LEFT = 0 | cat::KEY;         ///< モータ左キー押下
+constexpr ID KEY_MOTOR_RIGHT = 1 | cat::KEY;        ///< モータ右キー押下
 constexpr ID KEY_USR_BTN = 4 | cat::KEY;            ///< ユーザボタン押下
 constexpr ID USB_TX_REQ = 0 | cat::USB;             ///< USB送信要求
 constexpr ID ENCODER_DATA_NOTIFY = 0 | cat::PERIPH; ///< エンコーダデータ通知
 constexpr ID CURRENT_DATA_NOTIFY = 1 | cat::PERIPH; ///< 電流値通知
-constexpr ID APP_POINTER_NOTIFY = 0 | cat::SYSTEM;  ///< アプリケーションインスタンスポインタ通知
+constexpr ID MOTOR_STATUS_NOTIFY = 0 | cat::SYSTEM; ///< モータ状態通知
+constexpr ID MOTOR_GAINS_REQ = 0 | cat::CTRL;       ///< モータ制御ゲイン変更要求
+constexpr ID MOTOR_FEEDFORWARD_REQ = 1 | cat::CTRL; ///< モータ制御フィードフォワード係数変更要求
+constexpr ID MOTOR_GEAR_REQ = 2 | cat::CTRL;        ///< 電子ギア開始要求
+constexpr ID MOTOR_SYNC_MOVE_REQ = 3 | cat::CTRL;   ///< 同期移動開始要求
+constexpr ID MOTOR_COORD_STOP_REQ = 4 | cat::CTRL;  ///< 連動停止要求
 
+/// @note MOTOR_COUNT 個の配列を持つ付随データは、モータを増やすと Message::bytes（MAX_MAIL_DATA_SIZE）に収まらなくなる
+///       （EncoderData は MOTOR_COUNT が 3 以上、CurrentData は 4 以上）。その場合は publish / publishFromIRQ が
+///       付随データブロックで配信するので、上限は MAX_PAYLOAD_SIZE となる（Bind で確認する）。
+///       send / sendFromIRQ はブロックを使わないので、これらの種別には使えない。
+static_assert(MOTOR_COUNT <= 32, "MotorSyncMoveReq::axes is a 32-bit mask");
+
+/// @brief モータ左キー押下・モータ右キー押下 の付随データ
+struct KeyData
+{
+  uint32_t motor; ///< モータID
+};
 /// @brief エンコーダデータ通知 の付随データ
 struct EncoderData
 {
   int32_t rotary[MOTOR_COUNT];
   int32_t motor[MOTOR_COUNT];
   int32_t motorVelocity[MOTOR_COUNT];
+  float motorSpeed[MOTOR_COUNT]; ///< M/T法で求めたモータの速度（カウント/s）
+  uint32_t stamp;                ///< 全軸のカウンタをラッチした時刻（DWTのサイクル数）
+  uint16_t epoch[MOTOR_COUNT];   ///< モータIDごとに最後に反映したリセットの番号（resetEncoder の戻り値）
 };
 /// @brief 電流値通知 の付随データ
 struct CurrentData
@@ -44,9 +67,83 @@ struct CurrentData
   float busVoltage[MOTOR_COUNT];
   float shuntVoltage[MOTOR_COUNT];
 };
-/// @brief アプリケーションインスタンスポインタ通知 の付随データ
-struct AppPointer
+/// @brief モータ状態通知 の付随データ
+struct MotorStatus
+{
+  uint32_t motor;       ///< モータID
+  uint8_t mode;         ///< 制御モード（mik::MotorMode）
+  uint8_t tuner;        ///< 自動調整の状態（mik::RelayTuner::State）
+  uint8_t running;      ///< 稼働状態 @arg 1 稼働中 @arg 0 停止中
+  uint8_t reserved;     ///< 予約
+  float ultimateGain;   ///< 自動調整で求めた限界ゲイン
+  float ultimatePeriod; ///< 自動調整で求めた限界周期（s）
+  float current;        ///< 電流値
+  float busVoltage;     ///< バス電圧
+  int32_t encoder;      ///< エンコーダ値
+  int32_t velocity;     ///< 速度
+  int32_t nob;          ///< ノブの回転位置
+};
+/// @brief モータ制御ゲイン変更要求 の付随データ
+struct MotorGainsReq
+{
+  uint32_t motor;        ///< モータID
+  mik::MotorGains gains; ///< ゲイン
+};
+/// @brief モータ制御フィードフォワード係数変更要求 の付随データ
+struct MotorFeedforwardReq
+{
+  uint32_t motor;           ///< モータID
+  mik::MotorFeedforward ff; ///< フィードフォワード係数
+};
+/// @brief 電子ギア開始要求 の付随データ
+struct MotorGearReq
+{
+  uint32_t master;   ///< 主モータID
+  uint32_t follower; ///< 従動モータID
+  float ratio;       ///< 比率
+  float offset;      ///< オフセット
+};
+/// @brief 同期移動開始要求 の付随データ
+struct MotorSyncMoveReq
+{
+  uint32_t axes;             ///< 動かすモータ（ビットマスク）
+  float target[MOTOR_COUNT]; ///< 目標位置
+};
+
+template <>
+struct Traits<KEY_MOTOR_LEFT> : Bind<KeyData>
+{
+};
+template <>
+struct Traits<KEY_MOTOR_RIGHT> : Bind<KeyData>
+{
+};
+template <>
+struct Traits<ENCODER_DATA_NOTIFY> : Bind<EncoderData>
+{
+};
+template <>
+struct Traits<CURRENT_DATA_NOTIFY> : Bind<CurrentData>
+{
+};
+template <>
+struct Traits<MOTOR_STATUS_NOTIFY> : Bind<MotorStatus>
+{
+};
+template <>
+struct Traits<MOTOR_GAINS_REQ> : Bind<MotorGainsReq>
+{
+};
+template <>
+struct Traits<MOTOR_FEEDFORWARD_REQ> : Bind<MotorFeedforwardReq>
+{
+};
+template <>
+struct Traits<MOTOR_GEAR_REQ> : Bind<MotorGearReq>
+{
+};
+template <>
+struct Traits<MOTOR_SYNC_MOVE_REQ> : Bind<MotorSyncMoveReq>
 {
-  void *app;
 };
 } // namespace msg
\ No newline at end of file
@@ -5,30 +5,84 @@
 /// DO NOT USE THIS SOFTWARE WITHOUT THE SOFTWARE LICENSE AGREEMENT.
 
 #include "msglib.h"
+#include "common/alloc.hpp"
+#include "common/cycle_counter.hpp"
+#include "latency.h"
+#include "latest.hpp"
+#include "payload.h"
+#include "ring.hpp"
 
 #ifndef MAX_MAIL_INFO_COUNT
 #define MAX_MAIL_INFO_COUNT 16 ///< 登録できる最大スレッド数
 #endif
+#ifndef MAX_SUBSCRIPTION_COUNT
+#define MAX_SUBSCRIPTION_COUNT 16 ///< 登録できる最大購読数
+#endif
+
+namespace
+{
+/// @brief 上書き型スロット
+struct LatestSlot
+{
+  msg::ID type;                     ///< メッセージ種別
+  msg::Latest<msg::Message> latest; ///< 最新値
+  bool held;                        ///< 受信結果が参照中
+  LatestSlot *next;                 ///< 同じメールボックスの次のスロット
+};
+/// @brief 受信経路ごとの統計カウンタ
+struct LaneCounters
+{
+  std::atomic<uint32_t> depth;     ///< 受け付けてから解放されていないメッセージ数
+  std::atomic<uint32_t> highWater; ///< depth の最大値
+};
+/// @brief メールボックスの統計カウンタ
+struct Counters
+{
+  std::atomic<uint32_t> sent;        ///< 受け付けたメッセージ数
+  std::atomic<uint32_t> dropped;     ///< 送信に失敗したメッセージ数
+  std::atomic<uint32_t> overwritten; ///< 上書き型スロットで未読のまま上書きしたメッセージ数
+  LaneCounters lanes[3];             ///< メール・優先メール・リングバッファの統計カウンタ（Result::Source 順）
+};
+} // namespace
+
+/// @brief メールボックス
+struct msg::Mailbox
+{
+  osThreadId threadId;             ///< スレッドID
+  osMailQId mailId;                ///< メールID
+  osMailQId urgentId;              ///< 優先メールID
+  ID urgentType;                   ///< 優先メールで受け取るメッセージ種別
+  ID urgentMask;                   ///< 優先メールで受け取るメッセージ種別の比較ビット
+  osSemaphoreId doorbell;          ///< メール以外の受信経路がある場合に受信側を起こすセマフォ
+  Ring<Message> ring;              ///< 割り込み送信用リングバッファ
+  std::atomic<LatestSlot *> slots; ///< 上書き型スロットのリスト
+  Counters counters;               ///< 統計カウンタ
+};
 
 namespace
 {
-/// @brief メール情報
-struct MailInfo
+/// @brief 購読情報
+struct Subscription
 {
-  osThreadId threadId; ///< スレッドID
-  osMailQId mailId;    ///< メールID
+  std::atomic<msg::Mailbox *> mailbox; ///< 配信先メールボックス
+  msg::ID type;                        ///< 購読するメッセージ種別
+  msg::ID mask;                        ///< 比較するビット
 };
-/// メール情報実態
-MailInfo s_mails[MAX_MAIL_INFO_COUNT] = {};
-/// @brief 指定したスレッドIDと一致するメール情報取得
+/// メールボックス実態
+msg::Mailbox s_mails[MAX_MAIL_INFO_COUNT] = {};
+/// 購読情報実態
+Subscription s_subs[MAX_SUBSCRIPTION_COUNT] = {};
+/// 登録済み購読数
+std::atomic<uint32_t> s_subCount(0);
+/// @brief 指定したスレッドIDと一致するメールボックス取得
 /// @param [in] threadId スレッドID
-/// @retval 0以外　メール情報のポインタ
+/// @retval 0以外　メールボックスのポインタ
 /// @retval 0 見つからない
-MailInfo *find(osThreadId threadId)
+msg::Mailbox *find(osThreadId threadId)
 {
   for (uint32_t i = 0; i < MAX_MAIL_INFO_COUNT; ++i)
   {
-    MailInfo *info = &s_mails[i];
+    msg::Mailbox *info = &s_mails[i];
     if (info->threadId == threadId)
     {
       return info;
@@ -36,10 +90,317 @@ MailInfo *find(osThreadId threadId)
   }
   return 0;
 }
+/// @brief 2のべき乗に切り上げる
+/// @param [in] v 値
+/// @return v 以上で最小の2のべき乗
+uint32_t roundUpPow2(uint32_t v)
+{
+  uint32_t n = 1;
+  while (n < v)
+  {
+    n <<= 1;
+  }
+  return n;
+}
+/// @brief 受信経路の統計カウンタを取得する
+/// @param [in] info メールボックス
+/// @param [in] source 受信経路（MAIL / URGENT / RING）
+/// @return 統計カウンタ
+inline LaneCounters &laneCounters(msg::Mailbox *info, msg::Result::Source source)
+{
+  return info->counters.lanes[source - msg::Result::MAIL];
+}
+/// @brief キューに積むメッセージを数える
+/// @param [in] info メールボックス
+/// @param [in] source 積む受信経路（MAIL / URGENT / RING）
+/// @note 受信側が先に解放して depth を減らさないように、キューに積む前に呼び出すこと
+void countQueued(msg::Mailbox *info, msg::Result::Source source)
+{
+  info->counters.sent.fetch_add(1, std::memory_order_relaxed);
+  LaneCounters &c = laneCounters(info, source);
+  uint32_t depth = c.depth.fetch_add(1, std::memory_order_relaxed) + 1;
+  uint32_t high = c.highWater.load(std::memory_order_relaxed);
+  while (high < depth && !c.highWater.compare_exchange_weak(high, depth, std::memory_order_relaxed))
+  {
+  }
+}
+/// @brief キューに積めなかったメッセージを数え直す
+/// @param [in] info メールボックス
+/// @param [in] source 積もうとした受信経路
+inline void uncountQueued(msg::Mailbox *info, msg::Result::Source source)
+{
+  info->counters.sent.fetch_sub(1, std::memory_order_relaxed);
+  laneCounters(info, source).depth.fetch_sub(1, std::memory_order_relaxed);
+}
+/// @brief 送信に失敗したメッセージを数える
+/// @param [in] info メールボックス
+/// @param [in] status 送信結果
+/// @return status
+inline osStatus countDropped(msg::Mailbox *info, osStatus status)
+{
+  if (status != osOK)
+  {
+    info->counters.dropped.fetch_add(1, std::memory_order_relaxed);
+  }
+  return status;
+}
+/// @brief 受信側スレッドを起こす
+/// @param [in] info メールボックス
+inline void ringDoorbell(msg::Mailbox *info)
+{
+  if (info->doorbell)
+  {
+    osSemaphoreRelease(info->doorbell);
+  }
+}
+/// @brief 受信側スレッドを起こすセマフォを生成する
+/// @param [in] info メールボックス
+/// @retval true 成功（生成済みの場合も含む）
+/// @retval false 失敗
+bool createDoorbell(msg::Mailbox *info)
+{
+  if (info->doorbell)
+  {
+    return true;
+  }
+  osSemaphoreDef(doorbell);
+  osSemaphoreId doorbell = osSemaphoreCreate(osSemaphore(doorbell), 1);
+  if (doorbell == 0)
+  {
+    return false;
+  }
+  osSemaphoreWait(doorbell, 0); // 生成直後に取得可能な状態の場合があるため空にしておく
+  info->doorbell = doorbell;
+  return true;
+}
+/// @brief メッセージ種別に一致する上書き型スロットを取得する
+/// @param [in] info メールボックス
+/// @param [in] type メッセージ種別
+/// @retval 0以外 スロット
+/// @retval 0 上書き型でない
+LatestSlot *findLatest(msg::Mailbox *info, msg::ID type)
+{
+  for (LatestSlot *slot = info->slots.load(std::memory_order_acquire); slot; slot = slot->next)
+  {
+    if (slot->type == type)
+    {
+      return slot;
+    }
+  }
+  return 0;
+}
+/// @brief メッセージ種別を格納するメールを取得する
+/// @param [in] info メールボックス
+/// @param [in] type メッセージ種別
+/// @return 受信経路（MAIL / URGENT）
+inline msg::Result::Source laneOf(msg::Mailbox const *info, msg::ID type)
+{
+  return (info->urgentId && (type & info->urgentMask) == info->urgentType) ? msg::Result::URGENT : msg::Result::MAIL;
+}
+/// @brief 受信経路のメールIDを取得する
+/// @param [in] info メールボックス
+/// @param [in] source 受信経路（MAIL / URGENT）
+/// @return メールID
+inline osMailQId mailOf(msg::Mailbox const *info, msg::Result::Source source)
+{
+  return source == msg::Result::URGENT ? info->urgentId : info->mailId;
+}
+/// @brief 受信時刻を記録し、送信から受信までの遅延を計測する
+/// @param [in,out] m 受信したメッセージ（送信時刻はそのまま残す）
+inline void stampReceived(msg::Message *m)
+{
+  m->received = mik::CycleCounter::now();
+  msg::recordQueued(m->type, m->received - m->stamp);
+}
+/// @brief メールから１つ取り出す
+/// @param [in] info メールボックス
+/// @param [in] mailId メールID
+/// @param [in] source メッセージの格納元
+/// @param [in] millisec タイムアウト時間
+/// @return 受信結果
+msg::Result takeMail(msg::Mailbox *info, osMailQId mailId, msg::Result::Source source, uint32_t millisec)
+{
+  osEvent res = osMailGet(mailId, millisec);
+  if (res.status != osEventMail)
+  {
+    return msg::Result(res.status);
+  }
+  msg::Message *m = static_cast<msg::Message *>(res.value.p);
+  if (m)
+  {
+    stampReceived(m);
+  }
+  osStatus st = m ? osOK : osErrorValue;
+  return msg::Result(st, m, info, source);
+}
+/// @brief メッセージに値を書き込む
+/// @param [out] m メッセージ
+/// @param [in] type メッセージ種別
+/// @param [in] bytes 付随データ先頭ポインタ
+/// @param [in] size 付随データサイズ
+inline void fill(msg::Message *m, msg::ID type, void const *bytes, uint16_t size)
+{
+  m->type = type;
+  m->size = size;
+  m->payload = 0;
+  m->stamp = mik::CycleCounter::now();
+  if (0 < size && bytes)
+  {
+    memcpy(m->bytes, bytes, size);
+  }
+}
+/// @brief 上書き型スロットの書き込み先に残っているブロックを手放す
+/// @param [in] slot スロット
+/// @note 書き込み先のバッファは書き込み側だけが触るので、割り込みからも排他なしで呼び出せる。
+void releaseBack(LatestSlot *slot)
+{
+  msg::Message *m = slot->latest.back();
+  if (m->payload)
+  {
+    msg::freePayload(m->payload);
+    m->payload = 0;
+  }
+}
+/// @brief 上書き型スロットへ書き込む
+/// @param [in] info メールボックス
+/// @param [in] slot スロット
+/// @param [in] type メッセージ種別
+/// @param [in] bytes 付随データ先頭ポインタ（payload を渡す場合は使わない）
+/// @param [in] size 付随データサイズ
+/// @param [in] payload 付随データブロック（参照を１つ引き渡す）。0なら bytes を Message::bytes にコピーする
+/// @return osOK
+osStatus overwrite(msg::Mailbox *info, LatestSlot *slot, msg::ID type, void const *bytes, uint16_t size, void *payload = 0)
+{
+  releaseBack(slot);
+  msg::Message *m = slot->latest.back();
+  fill(m, type, payload ? 0 : bytes, size);
+  m->payload = payload;
+  info->counters.sent.fetch_add(1, std::memory_order_relaxed);
+  if (slot->latest.publish())
+  {
+    ringDoorbell(info);
+  }
+  else
+  {
+    info->counters.overwritten.fetch_add(1, std::memory_order_relaxed);
+    releaseBack(slot); // 未読のまま上書きされた値は書き込み先に戻ってくるので、そのブロックをすぐに手放す
+  }
+  return osOK;
+}
+/// @brief 購読情報とメッセージ種別が一致するか
+/// @param [in] sub 購読情報
+/// @param [in] type メッセージ種別
+/// @retval 0以外 配信先メールボックス
+/// @retval 0 一致しない
+inline msg::Mailbox *match(Subscription const &sub, msg::ID type)
+{
+  msg::Mailbox *mailbox = sub.mailbox.load(std::memory_order_acquire);
+  return (mailbox && (type & sub.mask) == sub.type) ? mailbox : 0;
+}
+/// @brief 待機せずに受信経路を優先順に確認し、メッセージを１つ取り出す
+/// @param [in] info メールボックス
+/// @param [out] m メッセージ
+/// @param [out] source メッセージの格納元
+/// @param [out] skipped 上書きされて受信しなかったメッセージ数
+/// @retval true 取り出した
+/// @retval false 全経路が空
+bool poll(msg::Mailbox *info, msg::Message *&m, msg::Result::Source &source, uint32_t &skipped)
+{
+  skipped = 0;
+  osMailQId lanes[] = {info->urgentId, info->mailId};
+  msg::Result::Source sources[] = {msg::Result::URGENT, msg::Result::MAIL};
+  for (uint32_t i = 0; i < 2; ++i)
+  {
+    if (lanes[i] == 0)
+    {
+      continue;
+    }
+    osEvent res = osMailGet(lanes[i], 0);
+    if (res.status == osEventMail && res.value.p)
+    {
+      m = static_cast<msg::Message *>(res.value.p);
+      source = sources[i];
+      stampReceived(m);
+      return true;
+    }
+  }
+  m = info->ring.valid() ? info->ring.pop() : 0;
+  if (m)
+  {
+    source = msg::Result::RING;
+    stampReceived(m);
+    return true;
+  }
+  for (LatestSlot *slot = info->slots.load(std::memory_order_acquire); slot; slot = slot->next)
+  {
+    m = slot->held ? 0 : slot->latest.take(skipped);
+    if (m)
+    {
+      slot->held = true;
+      source = msg::Result::LATEST;
+      stampReceived(m);
+      return true;
+    }
+  }
+  return false;
+}
+/// @brief 受信したメッセージを格納元へ返す
+/// @param [in] info メールボックス
+/// @param [in] source メッセージの格納元
+/// @param [in] m メッセージ
+void giveBack(msg::Mailbox *info, msg::Result::Source source, msg::Message *m)
+{
+  msg::recordHeld(m->type, mik::CycleCounter::now() - m->received);
+  if (source != msg::Result::LATEST)
+  {
+    laneCounters(info, source).depth.fetch_sub(1, std::memory_order_relaxed);
+  }
+  if (m->payload)
+  {
+    msg::freePayload(m->payload);
+    m->payload = 0; // 上書き型スロットのバッファは再利用されるので、手放したブロックを残さない
+  }
+  switch (source)
+  {
+  case msg::Result::MAIL:
+    osMailFree(info->mailId, m);
+    break;
+  case msg::Result::URGENT:
+    osMailFree(info->urgentId, m);
+    break;
+  case msg::Result::RING:
+    info->ring.release();
+    break;
+  case msg::Result::LATEST:
+  {
+    LatestSlot *slot = findLatest(info, m->type);
+    if (slot)
+    {
+      slot->held = false;
+    }
+    break;
+  }
+  default:
+    break;
+  }
+}
 } // namespace
 
 osStatus msg::registerThread(uint32_t msgCount) noexcept
 {
+  return registerThread(msgCount, 0);
+}
+
+osStatus msg::registerThread(uint32_t msgCount, uint32_t irqMsgCount) noexcept
+{
+  Mailbox *mailbox = 0;
+  return registerThread(msgCount, irqMsgCount, mailbox);
+}
+
+osStatus msg::registerThread(uint32_t msgCount, uint32_t irqMsgCount, Mailbox *&mailbox) noexcept
+{
+  mailbox = 0;
+  mik::CycleCounter::enable(); // メッセージの送受信時刻に使う
   osThreadId threadId = osThreadGetId();
   if (threadId == 0)
   {
@@ -49,15 +410,124 @@ osStatus msg::registerThread(uint32_t msgCount) noexcept
   {
     return osErrorValue;
   }
-  MailInfo *info = find(0);
+  Mailbox *info = find(0);
   if (info == 0)
   {
     return osErrorNoMemory;
   }
+  if (0 < irqMsgCount)
+  {
+    uint32_t size = roundUpPow2(irqMsgCount);
+    Message *buf = mik::allocArray<Message>(size);
+    if (buf == 0 || !createDoorbell(info))
+    {
+      return osErrorResource;
+    }
+    info->ring.init(buf, size);
+  }
   info->threadId = threadId;
   osMailQDef(mail, msgCount, Message);
   info->mailId = osMailCreate(osMailQ(mail), threadId);
-  return info->mailId ? osOK : osErrorResource;
+  if (info->mailId == 0)
+  {
+    return osErrorResource;
+  }
+  mailbox = info;
+  return osOK;
+}
+
+osStatus msg::registerLatest(Mailbox *mailbox, ID type) noexcept
+{
+  if (mailbox == 0 || mailbox->mailId == 0)
+  {
+    return osErrorParameter;
+  }
+  if (findLatest(mailbox, type))
+  {
+    return osOK;
+  }
+  LatestSlot *slot = mik::alloc<LatestSlot>();
+  if (slot == 0 || !createDoorbell(mailbox))
+  {
+    return osErrorNoMemory;
+  }
+  slot->type = type;
+  slot->next = mailbox->slots.load(std::memory_order_relaxed);
+  mailbox->slots.store(slot, std::memory_order_release);
+  return osOK;
+}
+
+osStatus msg::subscribe(Mailbox *mailbox, ID type, ID mask) noexcept
+{
+  if (mailbox == 0 || mailbox->mailId == 0)
+  {
+    return osErrorParameter;
+  }
+  uint32_t i = s_subCount.fetch_add(1, std::memory_order_relaxed);
+  if (MAX_SUBSCRIPTION_COUNT <= i)
+  {
+    s_subCount.store(MAX_SUBSCRIPTION_COUNT, std::memory_order_relaxed);
+    return osErrorNoMemory;
+  }
+  Subscription &sub = s_subs[i];
+  sub.type = type & mask;
+  sub.mask = mask;
+  sub.mailbox.store(mailbox, std::memory_order_release);
+  return osOK;
+}
+
+osStatus msg::registerUrgent(Mailbox *mailbox, ID type, ID mask, uint32_t msgCount) noexcept
+{
+  if (mailbox == 0 || mailbox->mailId == 0)
+  {
+    return osErrorParameter;
+  }
+  if (mailbox->urgentId)
+  {
+    return osErrorValue;
+  }
+  if (!createDoorbell(mailbox))
+  {
+    return osErrorResource;
+  }
+  osMailQDef(urgent, msgCount, Message);
+  osMailQId urgentId = osMailCreate(osMailQ(urgent), mailbox->threadId);
+  if (urgentId == 0)
+  {
+    return osErrorResource;
+  }
+  mailbox->urgentType = type & mask;
+  mailbox->urgentMask = mask;
+  mailbox->urgentId = urgentId;
+  return osOK;
+}
+
+osStatus msg::readStats(Mailbox const *mailbox, MailboxStats &stats) noexcept
+{
+  if (mailbox == 0 || mailbox->mailId == 0)
+  {
+    return osErrorParameter;
+  }
+  Counters const &c = mailbox->counters;
+  stats.sent = c.sent.load(std::memory_order_relaxed);
+  stats.dropped = c.dropped.load(std::memory_order_relaxed);
+  stats.overwritten = c.overwritten.load(std::memory_order_relaxed);
+  LaneStats *lanes[] = {&stats.mail, &stats.urgent, &stats.ring};
+  for (uint32_t i = 0; i < 3; ++i)
+  {
+    lanes[i]->depth = c.lanes[i].depth.load(std::memory_order_relaxed);
+    lanes[i]->highWater = c.lanes[i].highWater.load(std::memory_order_relaxed);
+  }
+  return osOK;
+}
+
+msg::Mailbox *msg::findMailbox(osThreadId threadId) noexcept
+{
+  if (threadId == 0)
+  {
+    return 0;
+  }
+  return find(threadId);
 }
 
 osStatus msg::send(osThreadId threadId, ID type) noexcept
@@ -67,27 +537,265 @@ osStatus msg::send(osThreadId threadId, ID type) noexcept
 
 osStatus msg::send(osThreadId threadId, ID type, void const *bytes, uint16_t size) noexcept
 {
-  MailInfo *info = find(threadId);
-  if (info == 0)
+  return send(threadId ? find(threadId) : 0, type, bytes, size);
+}
+
+osStatus msg::send(Mailbox *mailbox, ID type) noexcept
+{
+  return send(mailbox, type, 0, 0);
+}
+
+osStatus msg::send(Mailbox *mailbox, ID type, void const *bytes, uint16_t size) noexcept
+{
+  if (mailbox == 0 || mailbox->mailId == 0)
   {
     return osErrorParameter;
   }
-  if (sizeof(Message::bytes) <= size)
+  if (sizeof(Message::bytes) < size)
   {
-    return osErrorValue;
+    return countDropped(mailbox, osErrorValue);
   }
-  Message *m = static_cast<Message *>(osMailAlloc(info->mailId, 0));
+  LatestSlot *slot = findLatest(mailbox, type);
+  if (slot)
+  {
+    return overwrite(mailbox, slot, type, bytes, size);
+  }
+  Result::Source lane = laneOf(mailbox, type);
+  osMailQId mailId = mailOf(mailbox, lane);
+  Message *m = static_cast<Message *>(osMailAlloc(mailId, 0));
   if (m == 0)
   {
-    return osEventTimeout;
+    return countDropped(mailbox, osEventTimeout);
+  }
+  fill(m, type, bytes, size);
+  countQueued(mailbox, lane);
+  osStatus st = osMailPut(mailId, m);
+  if (st != osOK)
+  {
+    uncountQueued(mailbox, lane);
+    osMailFree(mailId, m);
+    return countDropped(mailbox, st);
+  }
+  ringDoorbell(mailbox);
+  return st;
+}
+
+osStatus msg::sendPayload(Mailbox *mailbox, ID type, void *payload, uint16_t size) noexcept
+{
+  if (mailbox == 0 || mailbox->mailId == 0 || payloadCapacity(payload) == 0)
+  {
+    freePayload(payload);
+    return osErrorParameter;
+  }
+  if (payloadCapacity(payload) < size)
+  {
+    freePayload(payload);
+    return countDropped(mailbox, osErrorValue);
+  }
+  Result::Source lane = laneOf(mailbox, type);
+  osMailQId mailId = mailOf(mailbox, lane);
+  Message *m = static_cast<Message *>(osMailAlloc(mailId, 0));
+  if (m == 0)
+  {
+    freePayload(payload);
+    return countDropped(mailbox, osEventTimeout);
   }
   m->type = type;
   m->size = size;
-  if (0 < size && bytes)
+  m->payload = payload;
+  m->stamp = mik::CycleCounter::now();
+  countQueued(mailbox, lane);
+  osStatus st = osMailPut(mailId, m);
+  if (st != osOK)
   {
-    memcpy(m->bytes, bytes, size);
+    uncountQueued(mailbox, lane);
+    osMailFree(mailId, m);
+    freePayload(payload);
+    return countDropped(mailbox, st);
+  }
+  ringDoorbell(mailbox);
+  return st;
+}
+
+osStatus msg::sendFromIRQ(Mailbox *mailbox, ID type, void const *bytes, uint16_t size) noexcept
+{
+  if (mailbox == 0)
+  {
+    return osErrorParameter;
+  }
+  if (sizeof(Message::bytes) < size)
+  {
+    return countDropped(mailbox, osErrorValue);
+  }
+  LatestSlot *slot = findLatest(mailbox, type);
+  if (slot)
+  {
+    return overwrite(mailbox, slot, type, bytes, size);
+  }
+  if (!mailbox->ring.valid())
+  {
+    return countDropped(mailbox, osErrorParameter);
+  }
+  Message *m = mailbox->ring.alloc();
+  if (m == 0)
+  {
+    return countDropped(mailbox, osEventTimeout);
   }
-  return osMailPut(info->mailId, m);
+  fill(m, type, bytes, size);
+  countQueued(mailbox, Result::RING);
+  if (mailbox->ring.commit())
+  {
+    ringDoorbell(mailbox);
+  }
+  return osOK;
+}
+
+osStatus msg::publish(ID type, void const *bytes, uint16_t size) noexcept
+{
+  osStatus res = osOK;
+  void *payload = 0;
+  uint32_t count = s_subCount.load(std::memory_order_acquire);
+  for (uint32_t i = 0; i < count && i < MAX_SUBSCRIPTION_COUNT; ++i)
+  {
+    Mailbox *mailbox = match(s_subs[i], type);
+    if (mailbox == 0)
+    {
+      continue;
+    }
+    osStatus st = osOK;
+    if (size <= sizeof(Message::bytes))
+    {
+      st = send(mailbox, type, bytes, size); // メッセージに収まるならブロックを使わずに直接コピーする
+    }
+    else
+    {
+      if (payload == 0)
+      {
+        payload = allocPayload(size); // 最初にブロックが必要になった時点で１度だけコピーする
+        if (payload == 0)
+        {
+          res = countDropped(mailbox, osErrorNoMemory);
+          continue;
+        }
+        if (bytes)
+        {
+          memcpy(payload, bytes, size);
+        }
+      }
+      retainPayload(payload);
+      LatestSlot *slot = findLatest(mailbox, type);
+      st = slot ? overwrite(mailbox, slot, type, 0, size, payload) : sendPayload(mailbox, type, payload, size);
+    }
+    if (st != osOK)
+    {
+      res = st;
+    }
+  }
+  if (payload)
+  {
+    freePayload(payload);
+  }
+  return res;
+}
+
+osStatus msg::publishPayload(ID type, void *payload, uint16_t size) noexcept
+{
+  osStatus res = osOK;
+  uint32_t count = s_subCount.load(std::memory_order_acquire);
+  for (uint32_t i = 0; i < count && i < MAX_SUBSCRIPTION_COUNT; ++i)
+  {
+    Mailbox *mailbox = match(s_subs[i], type);
+    if (mailbox == 0)
+    {
+      continue;
+    }
+    osStatus st = osOK;
+    LatestSlot *slot = findLatest(mailbox, type);
+    if (payload == 0 || (slot && size <= sizeof(Message::bytes)))
+    {
+      st = send(mailbox, type, payload, size);
+    }
+    else
+    {
+      retainPayload(payload);
+      st = slot ? overwrite(mailbox, slot, type, 0, size, payload) : sendPayload(mailbox, type, payload, size);
+    }
+    if (st != osOK)
+    {
+      res = st;
+    }
+  }
+  if (payload)
+  {
+    freePayload(payload);
+  }
+  return res;
+}
+
+osStatus msg::publishFromIRQ(ID type, void const *bytes, uint16_t size) noexcept
+{
+  osStatus res = osOK;
+  void *payload = 0;
+  uint32_t count = s_subCount.load(std::memory_order_acquire);
+  for (uint32_t i = 0; i < count && i < MAX_SUBSCRIPTION_COUNT; ++i)
+  {
+    Mailbox *mailbox = match(s_subs[i], type);
+    if (mailbox == 0)
+    {
+      continue;
+    }
+    LatestSlot *slot = findLatest(mailbox, type);
+    if (slot == 0 && !mailbox->ring.valid())
+    {
+      res = countDropped(mailbox, osErrorParameter);
+      continue;
+    }
+    if (payload == 0 && sizeof(Message::bytes) < size)
+    {
+      payload = allocPayload(size); // 最初にブロックが必要になった時点で１度だけコピーする
+      if (payload == 0)
+      {
+        res = countDropped(mailbox, osErrorNoMemory);
+        continue;
+      }
+      if (bytes)
+      {
+        memcpy(payload, bytes, size);
+      }
+    }
+    if (slot)
+    {
+      if (payload)
+      {
+        retainPayload(payload);
+      }
+      overwrite(mailbox, slot, type, bytes, size, payload);
+      continue;
+    }
+    Message *m = mailbox->ring.alloc();
+    if (m == 0)
+    {
+      res = countDropped(mailbox, osEventTimeout);
+      continue;
+    }
+    fill(m, type, payload ? 0 : bytes, payload ? 0 : size);
+    if (payload)
+    {
+      retainPayload(payload);
+      m->size = size;
+      m->payload = payload;
+    }
+    countQueued(mailbox, Result::RING);
+    if (mailbox->ring.commit())
+    {
+      ringDoorbell(mailbox);
+    }
+  }
+  if (payload)
+  {
+    freePayload(payload);
+  }
+  return res;
 }
 
 msg::Result msg::recv(uint32_t millisec) noexcept
@@ -97,31 +805,95 @@ msg::Result msg::recv(uint32_t millisec) noexcept
   {
     return Result(osErrorOS);
   }
-  MailInfo *info = find(threadId);
-  if (info == 0)
+  return recv(find(threadId), millisec);
+}
+
+msg::Result msg::recv(Mailbox *mailbox, uint32_t millisec) noexcept
+{
+  if (mailbox == 0 || mailbox->mailId == 0)
   {
     return Result(osErrorParameter);
   }
-  osEvent res = osMailGet(info->mailId, millisec);
-  if (res.status != osEventMail)
+  if (!mailbox->doorbell)
   {
-    return Result(res.status);
+    return takeMail(mailbox, mailbox->mailId, Result::MAIL, millisec);
+  }
+  // メール以外の受信経路がある場合は、優先メールから順に全経路を確認してから待機する
+  for (;;)
+  {
+    Message *m = 0;
+    Result::Source source = Result::NONE;
+    uint32_t skipped = 0;
+    if (poll(mailbox, m, source, skipped))
+    {
+      return Result(osOK, m, mailbox, source, skipped);
+    }
+    if (osSemaphoreWait(mailbox->doorbell, millisec) != osOK)
+    {
+      return Result(millisec ? osEventTimeout : osOK);
+    }
   }
-  Message *m = static_cast<Message *>(res.value.p);
-  osStatus st = m ? osOK : osErrorValue;
-  return Result(st, m, info->mailId);
 }
 
-msg::Result::Result(osStatus status, Message *msg, osMailQId mail) noexcept //
-    : status_(status),                                                      //
-      msg_(msg),                                                            //
-      mail_(mail)                                                           //
+osStatus msg::recvBatch(Mailbox *mailbox, Batch &batch, uint32_t millisec) noexcept
+{
+  batch.reset();
+  if (mailbox == 0 || mailbox->mailId == 0)
+  {
+    return osErrorParameter;
+  }
+  batch.mailbox_ = mailbox;
+  for (;;)
+  {
+    while (batch.count_ < MAX_BATCH_COUNT)
+    {
+      Batch::Entry &e = batch.entries_[batch.count_];
+      if (!poll(mailbox, e.msg, e.source, e.skipped))
+      {
+        break;
+      }
+      ++batch.count_;
+    }
+    if (0 < batch.count_ || millisec == 0)
+    {
+      return osOK;
+    }
+    // 空の場合だけ待機し、起床後に溜まっている分をまとめて取り出す
+    if (mailbox->doorbell)
+    {
+      if (osSemaphoreWait(mailbox->doorbell, millisec) != osOK)
+      {
+        return osEventTimeout;
+      }
+      continue;
+    }
+    osEvent res = osMailGet(mailbox->mailId, millisec);
+    if (res.status != osEventMail)
+    {
+      return res.status;
+    }
+    Batch::Entry &e = batch.entries_[batch.count_++];
+    e.msg = static_cast<Message *>(res.value.p);
+    e.source = Result::MAIL;
+    stampReceived(e.msg);
+    e.skipped = 0;
+  }
+}
+
+msg::Result::Result(osStatus status, Message *msg, Mailbox *mailbox, Source source, uint32_t skipped) noexcept //
+    : status_(status),                                                                                         //
+      msg_(msg),                                                                                               //
+      mailbox_(mailbox),                                                                                       //
+      source_(source),                                                                                         //
+      skipped_(skipped)                                                                                        //
 {
 }
 msg::Result::Result(osStatus status) noexcept //
     : status_(status),                        //
       msg_(0),                                //
-      mail_(0)                                //
+      mailbox_(0),                            //
+      source_(NONE),                          //
+      skipped_(0)                             //
 {
 }
 msg::Result::~Result()
@@ -131,11 +903,15 @@ msg::Result::~Result()
 msg::Result::Result(Result &&that) noexcept //
     : status_(that.status_),                //
       msg_(that.msg_),                      //
-      mail_(that.mail_)                     //
+      mailbox_(that.mailbox_),              //
+      source_(that.source_),                //
+      skipped_(that.skipped_)               //
 {
   that.status_ = osOK;
   that.msg_ = 0;
-  that.mail_ = 0;
+  that.mailbox_ = 0;
+  that.source_ = NONE;
+  that.skipped_ = 0;
 }
 msg::Result &msg::Result::operator=(Result &&that) noexcept
 {
@@ -144,10 +920,14 @@ msg::Result &msg::Result::operator=(Result &&that) noexcept
     reset();
     status_ = that.status_;
     msg_ = that.msg_;
-    mail_ = that.mail_;
+    mailbox_ = that.mailbox_;
+    source_ = that.source_;
+    skipped_ = that.skipped_;
     that.status_ = osOK;
     that.msg_ = 0;
-    that.mail_ = 0;
+    that.mailbox_ = 0;
+    that.source_ = NONE;
+    that.skipped_ = 0;
   }
   return *this;
 }
@@ -155,7 +935,7 @@ void msg::Result::reset() noexcept
 {
   if (msg_)
   {
-    osMailFree(mail_, msg_);
+    giveBack(mailbox_, source_, msg_);
     msg_ = 0;
   }
 }
@@ -166,4 +946,53 @@ osStatus msg::Result::status() const noexcept
 msg::Message const *msg::Result::msg() const noexcept
 {
   return msg_;
+}
+uint32_t msg::Result::skipped() const noexcept
+{
+  return skipped_;
+}
+msg::Batch::Batch() noexcept : entries_(), count_(0), mailbox_(0)
+{
+}
+msg::Batch::~Batch()
+{
+  reset();
+}
+void msg::Batch::reset() noexcept
+{
+  uint32_t rings = 0;
+  for (uint32_t i = 0; i < count_; ++i)
+  {
+    Entry &e = entries_[i];
+    if (e.source != Result::RING)
+    {
+      giveBack(mailbox_, e.source, e.msg);
+      continue;
+    }
+    recordHeld(e.msg->type, mik::CycleCounter::now() - e.msg->received);
+    laneCounters(mailbox_, Result::RING).depth.fetch_sub(1, std::memory_order_relaxed);
+    if (e.msg->payload)
+    {
+      freePayload(e.msg->payload);
+    }
+    ++rings;
+  }
+  if (0 < rings)
+  {
+    mailbox_->ring.release(rings); // リングバッファの要素は古い順に取り出しているので、まとめて解放できる
+  }
+  count_ = 0;
+  mailbox_ = 0;
+}
+uint32_t msg::Batch::count() const noexcept
+{
+  return count_;
+}
+msg::Message const *msg::Batch::msg(uint32_t i) const noexcept
+{
+  return i < count_ ? entries_[i].msg : 0;
+}
+uint32_t msg::Batch::skipped(uint32_t i) const noexcept
+{
+  return i < count_ ? entries_[i].skipped : 0;
 }
\ No newline at end of file
@@ -10,13 +10,20 @@
 #include <cstring> // to use 'memcpy'
 
 #ifndef MAX_MAIL_DATA_SIZE
-#define MAX_MAIL_DATA_SIZE 32 ///< 付随データの最大長
+#define MAX_MAIL_DATA_SIZE 40 ///< 付随データの最大長
+#endif
+#ifndef MAX_BATCH_COUNT
+#define MAX_BATCH_COUNT 8 ///< まとめて受信できる最大メッセージ数
 #endif
 
 namespace msg
 {
 struct Message;
+struct Mailbox;
+struct LaneStats;
+struct MailboxStats;
 class Result;
+class Batch;
 using ID = uint16_t; ///< メッセージID型
 
 /// @brief 自スレッドをメッセージ送信先に登録
@@ -24,6 +31,67 @@ using ID = uint16_t; ///< メッセージID型
 /// @retval osOK 成功
 /// @retval それ以外 失敗理由
 osStatus registerThread(uint32_t msgCount) noexcept;
+/// @brief 自スレッドをメッセージ送信先に登録し、割り込み送信用のリングバッファを付加する
+/// @param [in] msgCount 格納できる最大メッセージ数
+/// @param [in] irqMsgCount 割り込みから格納できる最大メッセージ数（2のべき乗に切り上げる）
+/// @retval osOK 成功
+/// @retval それ以外 失敗理由
+osStatus registerThread(uint32_t msgCount, uint32_t irqMsgCount) noexcept;
+/// @brief 自スレッドをメッセージ送信先に登録し、メールボックスを取得する
+/// @param [in] msgCount 格納できる最大メッセージ数
+/// @param [in] irqMsgCount 割り込みから格納できる最大メッセージ数（0ならリングバッファを付加しない）
+/// @param [out] mailbox 登録したメールボックス
+/// @retval osOK 成功
+/// @retval それ以外 失敗理由
+/// @note 取得したメールボックスを send / recv に渡すと、送信先の検索を省略できる
+osStatus registerThread(uint32_t msgCount, uint32_t irqMsgCount, Mailbox *&mailbox) noexcept;
+/// @brief メッセージ種別を上書き型にする
+/// @param [in] mailbox 自スレッドのメールボックス
+/// @param [in] type メッセージ種別
+/// @retval osOK 成功
+/// @retval osErrorParameter メールボックスが未登録
+/// @retval osErrorNoMemory メモリ確保失敗
+/// @note 以降この種別のメッセージはキューに積まず、１つのスロットを最新値で上書きする。
+///       受信側は常に最新値を受け取り、上書きされた数は Result::skipped で取得できる。
+///       種別ごとに送信元は１つ（１タスクまたは１割り込み）に限ること。
+///       Message::bytes に収まらない付随データは publish / publishFromIRQ でブロックとして書き込む。
+///       この場合スロットは受信中と未読の値のブロックを持つので、種別ごとにサイズクラスのブロックを２つ使う。
+osStatus registerLatest(Mailbox *mailbox, ID type) noexcept;
+/// @brief メッセージ種別を優先メールで受け取るようにする
+/// @param [in] mailbox 自スレッドのメールボックス
+/// @param [in] type 優先するメッセージ種別
+/// @param [in] mask 種別のうち比較するビット（カテゴリ単位で優先する場合は cat::MASK）
+/// @param [in] msgCount 優先メールに格納できる最大メッセージ数
+/// @retval osOK 成功
+/// @retval osErrorParameter メールボックスが未登録
+/// @retval osErrorValue 登録済み（１メールボックスにつき１つまで）
+/// @retval osErrorResource 優先メールを生成できない
+/// @note 優先メールは通常のメールとは別のキューに積まれ、recv は常に優先メールから取り出す。
+///       センサデータが溜まっていても、停止操作などの制御メッセージを先に処理できる。
+osStatus registerUrgent(Mailbox *mailbox, ID type, ID mask, uint32_t msgCount) noexcept;
+/// @brief メッセージ種別を購読する
+/// @param [in] mailbox 配信先メールボックス（自スレッドのもの）
+/// @param [in] type 購読するメッセージ種別
+/// @param [in] mask 種別のうち比較するビット（カテゴリ単位で購読する場合は cat::MASK）
+/// @retval osOK 成功
+/// @retval osErrorParameter メールボックスが未登録
+/// @retval osErrorNoMemory 購読数が上限に達している
+/// @note publish / publishFromIRQ で送信したメッセージが、一致する全ての購読者に配信される
+osStatus subscribe(Mailbox *mailbox, ID type, ID mask = 0xFFFF) noexcept;
+/// @brief メールボックスの統計カウンタを取得する
+/// @param [in] mailbox メールボックス
+/// @param [out] stats 統計カウンタ
+/// @retval osOK 成功
+/// @retval osErrorParameter メールボックスが未登録
+/// @note registerThread の msgCount は mail.highWater を、irqMsgCount は ring.highWater を、
+///       registerUrgent の msgCount は urgent.highWater を見て決めること。取りこぼしは dropped で分かる。
+osStatus readStats(Mailbox const *mailbox, MailboxStats &stats) noexcept;
+/// @brief 送信先スレッドのメールボックスを取得する
+/// @param [in] threadId 送信先スレッドID
+/// @retval 0以外 メールボックス
+/// @retval 0 送信先が未登録
+/// @note 割り込みから送信する場合は、あらかじめタスク側で取得しておくこと
+Mailbox *findMailbox(osThreadId threadId) noexcept;
 /// @brief メッセージ送信
 /// @param [in] threadId 送信先スレッドID
 /// @param [in] type メッセージ種別
@@ -58,10 +126,160 @@ osStatus send(osThreadId threadId, ID type, T const &data) noexcept
 {
   return send(threadId, type, &data, sizeof(data));
 }
+/// @brief メッセージ送信
+/// @param [in] mailbox 送信先メールボックス
+/// @param [in] type メッセージ種別
+/// @retval osOK 送信成功
+/// @retval osErrorParameter 送信先が未登録
+/// @retval osEventTimeout タイムアウト発生
+/// @retval osErrorOS 送信失敗
+osStatus send(Mailbox *mailbox, ID type) noexcept;
+/// @brief メッセージ送信
+/// @param [in] mailbox 送信先メールボックス
+/// @param [in] type メッセージ種別
+/// @param [in] bytes 付随データ先頭ポインタ
+/// @param [in] size 付随データサイズ
+/// @retval osOK 送信成功
+/// @retval osErrorParameter 送信先が未登録
+/// @retval osErrorValue 付随データサイズが送信可能な最大長を超えている
+/// @retval osEventTimeout タイムアウト発生
+/// @retval osErrorOS 送信失敗
+osStatus send(Mailbox *mailbox, ID type, void const *bytes, uint16_t size) noexcept;
+/// @brief メッセージ送信
+/// @tparam T 付随データ型
+/// @param [in] mailbox 送信先メールボックス
+/// @param [in] type メッセージ種別
+/// @param [in] data 付随データ
+/// @retval osOK 送信成功
+/// @retval osErrorParameter 送信先が未登録
+/// @retval osErrorValue 付随データサイズが送信可能な最大長を超えている
+/// @retval osEventTimeout タイムアウト発生
+/// @retval osErrorOS 送信失敗
+template <typename T>
+osStatus send(Mailbox *mailbox, ID type, T const &data) noexcept
+{
+  return send(mailbox, type, &data, sizeof(data));
+}
+/// @brief 付随データブロックを送信する（コピーなし）
+/// @param [in] mailbox 送信先メールボックス
+/// @param [in] type メッセージ種別
+/// @param [in] payload allocPayload で確保し、書き込み済みの付随データブロック
+/// @param [in] size 付随データサイズ
+/// @retval osOK 送信成功
+/// @retval osErrorParameter 送信先が未登録、またはブロックでない
+/// @retval osErrorValue 付随データサイズがブロック容量を超えている
+/// @retval osEventTimeout タイムアウト発生
+/// @retval osErrorOS 送信失敗
+/// @note 成否にかかわらずブロックの所有権は移る。送信に失敗したブロックはここで解放する。
+osStatus sendPayload(Mailbox *mailbox, ID type, void *payload, uint16_t size) noexcept;
+/// @brief 付随データブロックを送信する（コピーなし）
+/// @tparam T 付随データ型
+/// @param [in] mailbox 送信先メールボックス
+/// @param [in] type メッセージ種別
+/// @param [in] payload allocPayload で確保し、書き込み済みの付随データ
+/// @retval osOK 送信成功
+/// @retval それ以外 失敗理由
+template <typename T>
+osStatus sendPayload(Mailbox *mailbox, ID type, T *payload) noexcept
+{
+  return sendPayload(mailbox, type, payload, sizeof(T));
+}
+/// @brief 割り込みからメッセージ送信
+/// @param [in] mailbox 送信先メールボックス
+/// @param [in] type メッセージ種別
+/// @param [in] bytes 付随データ先頭ポインタ
+/// @param [in] size 付随データサイズ
+/// @retval osOK 送信成功
+/// @retval osErrorParameter 送信先にリングバッファが付加されていない
+/// @retval osErrorValue 付随データサイズが送信可能な最大長を超えている
+/// @retval osEventTimeout リングバッファが満杯
+/// @note 定数時間で完了する。RTOSを呼び出すのは受信側が待機している可能性がある場合のみ。
+osStatus sendFromIRQ(Mailbox *mailbox, ID type, void const *bytes, uint16_t size) noexcept;
+/// @brief 割り込みからメッセージ送信
+/// @tparam T 付随データ型
+/// @param [in] mailbox 送信先メールボックス
+/// @param [in] type メッセージ種別
+/// @param [in] data 付随データ
+/// @retval osOK 送信成功
+/// @retval osErrorParameter 送信先にリングバッファが付加されていない
+/// @retval osErrorValue 付随データサイズが送信可能な最大長を超えている
+/// @retval osEventTimeout リングバッファが満杯
+template <typename T>
+osStatus sendFromIRQ(Mailbox *mailbox, ID type, T const &data) noexcept
+{
+  return sendFromIRQ(mailbox, type, &data, sizeof(data));
+}
+/// @brief 購読者全員にメッセージを配信する
+/// @param [in] type メッセージ種別
+/// @param [in] bytes 付随データ先頭ポインタ
+/// @param [in] size 付随データサイズ
+/// @retval osOK 全ての購読者に配信した（購読者がいない場合も含む）
+/// @retval osErrorNoMemory 付随データブロックを確保できない
+/// @retval それ以外 配信できなかった購読者がいる（最後の失敗理由）
+/// @note 付随データが Message::bytes に収まる場合は、各購読者のメッセージへ直接コピーしてブロックを使わない。
+///       収まらない場合は最初に必要になった時点で１つのブロックにだけコピーし、参照カウントで全購読者が共有する。
+///       上書き型スロットで受け取る購読者にもブロックのまま書き込む。
+///       ブロックを確保できなかった購読者は dropped に数える。
+osStatus publish(ID type, void const *bytes, uint16_t size) noexcept;
+/// @brief 購読者全員にメッセージを配信する
+/// @tparam T 付随データ型
+/// @param [in] type メッセージ種別
+/// @param [in] data 付随データ
+/// @retval osOK 全ての購読者に配信した
+/// @retval それ以外 失敗理由
+template <typename T>
+osStatus publish(ID type, T const &data) noexcept
+{
+  return publish(type, &data, sizeof(data));
+}
+/// @brief 書き込み済みの付随データブロックを購読者全員に配信する（コピーなし）
+/// @param [in] type メッセージ種別
+/// @param [in] payload allocPayload で確保し、書き込み済みの付随データブロック
+/// @param [in] size 付随データサイズ
+/// @retval osOK 全ての購読者に配信した
+/// @retval それ以外 配信できなかった購読者がいる（最後の失敗理由）
+/// @note ブロックの参照は呼び出し側から手放される
+osStatus publishPayload(ID type, void *payload, uint16_t size) noexcept;
+/// @brief 割り込みから購読者全員にメッセージを配信する
+/// @param [in] type メッセージ種別
+/// @param [in] bytes 付随データ先頭ポインタ
+/// @param [in] size 付随データサイズ
+/// @retval osOK 全ての購読者に配信した
+/// @retval osErrorParameter リングバッファも上書き型スロットも持たない購読者がいる
+/// @retval osErrorNoMemory 付随データブロックを確保できない
+/// @retval osEventTimeout リングバッファが満杯の購読者がいる
+/// @note ブロックを使う条件は publish と同じ
+osStatus publishFromIRQ(ID type, void const *bytes, uint16_t size) noexcept;
+/// @brief 割り込みから購読者全員にメッセージを配信する
+/// @tparam T 付随データ型
+/// @param [in] type メッセージ種別
+/// @param [in] data 付随データ
+/// @retval osOK 全ての購読者に配信した
+/// @retval それ以外 失敗理由
+template <typename T>
+osStatus publishFromIRQ(ID type, T const &data) noexcept
+{
+  return publishFromIRQ(type, &data, sizeof(data));
+}
 /// @brief メッセージ受信
 /// @param [in] millisec タイムアウト時間
 /// @return 受信結果
 Result recv(uint32_t millisec = osWaitForever) noexcept;
+/// @brief メッセージ受信
+/// @param [in] mailbox 自スレッドのメールボックス
+/// @param [in] millisec タイムアウト時間
+/// @return 受信結果
+Result recv(Mailbox *mailbox, uint32_t millisec) noexcept;
+/// @brief 溜まっているメッセージをまとめて受信する
+/// @param [in] mailbox 自スレッドのメールボックス
+/// @param [out] batch 受信結果（前回の受信結果は解放してから格納する）
+/// @param [in] millisec タイムアウト時間（1件も無い場合だけ待機する）
+/// @retval osOK 成功（millisec が0の場合は0件の場合も含む）
+/// @retval osErrorParameter メールボックスが未登録
+/// @retval osEventTimeout タイムアウト発生
+/// @note 起床１回で最大 MAX_BATCH_COUNT 件を recv と同じ優先順で取り出し、batch の破棄時にまとめて解放する。
+///       上書き型スロットは１回の受信で種別ごとに１件までとなる。
+osStatus recvBatch(Mailbox *mailbox, Batch &batch, uint32_t millisec) noexcept;
 } // namespace msg
 
 /// @brief メッセージ型
@@ -69,8 +287,14 @@ struct msg::Message
 {
   ID type;                           ///< メッセージ種別
   uint16_t size;                     ///< 付随データサイズ
+  uint32_t stamp;                    ///< 送信時刻のサイクル数
+  uint32_t received;                 ///< 受信時刻のサイクル数（受信から解放までの遅延の計測に使う）
+  void *payload;                     ///< 付随データブロック（0なら bytes に格納）
   uint8_t bytes[MAX_MAIL_DATA_SIZE]; ///< 付随データ
 
+  /// @brief 付随データ先頭ポインタを取得する
+  /// @return 付随データ先頭ポインタ
+  void const *data() const { return payload ? payload : bytes; }
   /// @brief 付随データを任意の型の変換して取得する
   /// @tparam T  変換する型
   /// @return 変換値
@@ -78,28 +302,73 @@ struct msg::Message
   T get() const
   {
     T t;
-    memcpy(&t, bytes, size);
+    memcpy(&t, data(), size < sizeof(t) ? size : sizeof(t));
     return t;
   }
+  /// @brief 付随データを任意の型として参照する（コピーなし）
+  /// @tparam T 参照する型
+  /// @retval 0以外 付随データ
+  /// @retval 0 付随データサイズが型より小さい
+  template <typename T>
+  T const *view() const
+  {
+    return sizeof(T) <= size ? static_cast<T const *>(data()) : 0;
+  }
+};
+
+/// @brief 受信経路ごとの統計カウンタ
+struct msg::LaneStats
+{
+  uint32_t depth;     ///< 受け付けてから解放されていないメッセージ数
+  uint32_t highWater; ///< depth の最大値
+};
+
+/// @brief メールボックスの統計カウンタ
+/// @note 送信元を問わず、メールボックスに届いた全てのメッセージを数える。
+///       dropped には付随データブロックを確保できずに配信しなかったメッセージも含む。
+struct msg::MailboxStats
+{
+  uint32_t sent;        ///< 受け付けたメッセージ数
+  uint32_t dropped;     ///< 満杯などで送信に失敗したメッセージ数
+  uint32_t overwritten; ///< 上書き型スロットで未読のまま上書きしたメッセージ数
+  LaneStats mail;       ///< メール
+  LaneStats urgent;     ///< 優先メール
+  LaneStats ring;       ///< 割り込み送信用リングバッファ
 };
 
 /// @brief 受信結果型
 class msg::Result
 {
+public:
+  /// @brief メッセージの格納元
+  enum Source
+  {
+    NONE = 0, ///< メッセージなし
+    MAIL,     ///< メールキュー
+    URGENT,   ///< 優先メールキュー
+    RING,     ///< 割り込み送信用リングバッファ
+    LATEST,   ///< 上書き型スロット
+  };
+
+private:
   Result() = delete;                          ///< デフォルトコンストラクタ削除
   Result(Result const &) = delete;            ///< コピーコンストラクタ削除
   Result &operator=(Result const &) = delete; ///< 代入演算子削除
 
-  osStatus status_; ///< 受信ステータス
-  Message *msg_;    ///< メッセージ
-  osMailQId mail_;  ///< メールID
+  osStatus status_;  ///< 受信ステータス
+  Message *msg_;     ///< メッセージ
+  Mailbox *mailbox_; ///< メッセージを格納していたメールボックス
+  Source source_;    ///< メッセージの格納元
+  uint32_t skipped_; ///< 上書きされて受信しなかったメッセージ数
 
 public:
   /// @brief コンストラクタ
   /// @param [in] status 受信ステータス
   /// @param [in] msg メッセージ
-  /// @param [in] mail メールID
-  explicit Result(osStatus status, Message *msg, osMailQId mail) noexcept;
+  /// @param [in] mailbox メッセージを格納していたメールボックス
+  /// @param [in] source メッセージの格納元
+  /// @param [in] skipped 上書きされて受信しなかったメッセージ数
+  explicit Result(osStatus status, Message *msg, Mailbox *mailbox, Source source, uint32_t skipped = 0) noexcept;
   /// @brief コンストラクタ
   /// @param [in] status 受信ステータス
   explicit Result(osStatus status) noexcept;
@@ -119,4 +388,47 @@ public:
   /// @brief メッセージ取得
   /// @return メッセージ
   Message const *msg() const noexcept;
+  /// @brief 上書きされて受信しなかったメッセージ数を取得する
+  /// @return 前回受信してから上書きされたメッセージ数（上書き型スロット以外は常に0）
+  uint32_t skipped() const noexcept;
+};
+
+/// @brief まとめて受信した結果型
+class msg::Batch
+{
+  Batch(Batch const &) = delete;            ///< コピーコンストラクタ削除
+  Batch &operator=(Batch const &) = delete; ///< 代入演算子削除
+
+  /// @brief 受信したメッセージ
+  struct Entry
+  {
+    Message *msg;          ///< メッセージ
+    Result::Source source; ///< メッセージの格納元
+    uint32_t skipped;      ///< 上書きされて受信しなかったメッセージ数
+  };
+  Entry entries_[MAX_BATCH_COUNT]; ///< 受信したメッセージ（受信順）
+  uint32_t count_;                 ///< 受信したメッセージ数
+  Mailbox *mailbox_;               ///< メッセージを格納していたメールボックス
+
+  friend osStatus recvBatch(Mailbox *mailbox, Batch &batch, uint32_t millisec) noexcept;
+
+public:
+  /// @brief コンストラクタ
+  Batch() noexcept;
+  /// @brief デストラクタ
+  virtual ~Batch();
+  /// @brief 受信したメッセージをまとめて解放する
+  void reset() noexcept;
+  /// @brief 受信したメッセージ数を取得する
+  /// @return メッセージ数
+  uint32_t count() const noexcept;
+  /// @brief メッセージ取得
+  /// @param [in] i 受信順の番号
+  /// @retval 0以外 メッセージ
+  /// @retval 0 番号が範囲外
+  Message const *msg(uint32_t i) const noexcept;
+  /// @brief 上書きされて受信しなかったメッセージ数を取得する
+  /// @param [in] i 受信順の番号
+  /// @return 前回受信してから上書きされたメッセージ数（上書き型スロット以外は常に0）
+  uint32_t skipped(uint32_t i) const noexcept;
 };
\ No newline at end of file
@@ -0,0 +1,157 @@
+/// @file      message/payload.cpp
+/// @author    Hiroshi Mikuriya
+/// @copyright Copyright© 2022 Hiroshi Mikuriya
+///
+/// DO NOT USE THIS SOFTWARE WITHOUT THE SOFTWARE LICENSE AGREEMENT.
+
+#include "payload.h"
+#include "common/interrupt_lock.hpp"
+#include "common/mutex.hpp"
+
+namespace
+{
+/// @brief 固定長ブロックプール
+/// @note 未使用ブロックは先頭4バイトを次の未使用ブロックへのポインタとして連結する。
+///       一度も払い出していないブロックは next_ で順に払い出すので、初期化処理は不要。
+///       ブロックごとに参照カウントを持ち、全ての参照が手放されたら解放する。
+class BlockPool
+{
+  uint8_t *storage_;   ///< ブロック領域
+  uint8_t *refs_;      ///< ブロックごとの参照カウント
+  uint16_t blockSize_; ///< ブロックサイズ
+  uint16_t count_;     ///< ブロック数
+  uint16_t next_;      ///< 一度も払い出していないブロックの先頭番号
+  void *free_;         ///< 解放済みブロックのリスト
+
+public:
+  /// @brief コンストラクタ
+  /// @param [in] storage ブロック領域
+  /// @param [in] refs ブロックごとの参照カウント領域
+  /// @param [in] blockSize ブロックサイズ
+  /// @param [in] count ブロック数
+  constexpr BlockPool(uint8_t *storage, uint8_t *refs, uint16_t blockSize, uint16_t count) //
+      : storage_(storage), refs_(refs), blockSize_(blockSize), count_(count), next_(0), free_(0)
+  {
+  }
+  /// @brief ブロックサイズを取得する @return ブロックサイズ
+  uint16_t blockSize() const { return blockSize_; }
+  /// @brief ブロックがこのプールのものか
+  /// @param [in] p ブロック
+  /// @retval true このプールのブロック
+  /// @retval false 別のプールのブロック
+  bool contains(void const *p) const
+  {
+    auto *b = static_cast<uint8_t const *>(p);
+    return storage_ <= b && b < storage_ + blockSize_ * count_;
+  }
+  /// @brief ブロックを確保する（排他済みで呼び出すこと）
+  /// @retval 0以外 参照カウント1のブロック
+  /// @retval 0 空きなし
+  void *alloc()
+  {
+    void *p = 0;
+    if (free_)
+    {
+      p = free_;
+      free_ = *static_cast<void **>(p);
+    }
+    else if (next_ < count_)
+    {
+      p = storage_ + blockSize_ * next_++;
+    }
+    if (p)
+    {
+      ref(p) = 1;
+    }
+    return p;
+  }
+  /// @brief 参照カウントを取得する（排他済みで呼び出すこと）
+  /// @param [in] p ブロック
+  /// @return 参照カウント
+  uint8_t &ref(void const *p) { return refs_[(static_cast<uint8_t const *>(p) - storage_) / blockSize_]; }
+  /// @brief 参照を１つ手放し、0になったらブロックを解放する（排他済みで呼び出すこと）
+  /// @param [in] p ブロック
+  void release(void *p)
+  {
+    if (ref(p) == 0 || --ref(p) != 0)
+    {
+      return;
+    }
+    *static_cast<void **>(p) = free_;
+    free_ = p;
+  }
+};
+
+alignas(8) uint8_t s_small[64 * 8];                    ///< 64バイトクラスの領域
+alignas(8) uint8_t s_medium[256 * 4];                  ///< 256バイトクラスの領域
+alignas(8) uint8_t s_large[msg::MAX_PAYLOAD_SIZE * 2]; ///< 1024バイトクラスの領域
+uint8_t s_smallRefs[8];                                ///< 64バイトクラスの参照カウント
+uint8_t s_mediumRefs[4];                               ///< 256バイトクラスの参照カウント
+uint8_t s_largeRefs[2];                                ///< 1024バイトクラスの参照カウント
+/// サイズクラス別プール（小さい順）
+BlockPool s_pools[] = {
+    BlockPool(s_small, s_smallRefs, 64, 8),
+    BlockPool(s_medium, s_mediumRefs, 256, 4),
+    BlockPool(s_large, s_largeRefs, msg::MAX_PAYLOAD_SIZE, 2),
+};
+mik::InterruptLock s_lock; ///< プール操作の排他
+
+/// @brief ブロックが属するプールを取得する
+/// @param [in] p ブロック
+/// @retval 0以外 プール
+/// @retval 0 どのプールのブロックでもない
+BlockPool *owner(void const *p)
+{
+  for (auto &pool : s_pools)
+  {
+    if (pool.contains(p))
+    {
+      return &pool;
+    }
+  }
+  return 0;
+}
+} // namespace
+
+void *msg::allocPayload(uint16_t size) noexcept
+{
+  for (auto &pool : s_pools)
+  {
+    if (size <= pool.blockSize())
+    {
+      mik::LockGuard<mik::InterruptLock> lock(s_lock);
+      void *p = pool.alloc();
+      if (p)
+      {
+        return p;
+      }
+    }
+  }
+  return 0;
+}
+
+void msg::retainPayload(void *payload) noexcept
+{
+  BlockPool *pool = owner(payload);
+  if (pool)
+  {
+    mik::LockGuard<mik::InterruptLock> lock(s_lock);
+    ++pool->ref(payload);
+  }
+}
+
+void msg::freePayload(void *payload) noexcept
+{
+  BlockPool *pool = owner(payload);
+  if (pool)
+  {
+    mik::LockGuard<mik::InterruptLock> lock(s_lock);
+    pool->release(payload);
+  }
+}
+
+uint16_t msg::payloadCapacity(void const *payload) noexcept
+{
+  BlockPool *pool = owner(payload);
+  return pool ? pool->blockSize() : 0;
+}
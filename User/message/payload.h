@@ -0,0 +1,47 @@
+/// @file      message/payload.h
+/// @author    Hiroshi Mikuriya
+/// @copyright Copyright© 2022 Hiroshi Mikuriya
+///
+/// DO NOT USE THIS SOFTWARE WITHOUT THE SOFTWARE LICENSE AGREEMENT.
+
+#pragma once
+
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+namespace msg
+{
+constexpr uint16_t MAX_PAYLOAD_SIZE = 1024; ///< 付随データブロックの最大サイズ（最も大きいサイズクラス）
+
+/// @brief 付随データブロックを確保する
+/// @param [in] size 必要なサイズ
+/// @retval 0以外 ブロック先頭ポインタ
+/// @retval 0 サイズに合うブロックが残っていない
+/// @note 割り込みからも呼び出せる。
+///       サイズクラス（64 / 256 / 1024バイト）のうち、size が収まる最小のプールから確保する。
+void *allocPayload(uint16_t size) noexcept;
+/// @brief 付随データブロックの参照を手放す（参照が無くなったら解放する）
+/// @param [in] payload allocPayload で確保したブロック
+/// @note 送信したブロックは受信結果の破棄時に手放されるので、呼び出す必要はない
+void freePayload(void *payload) noexcept;
+/// @brief 付随データブロックの参照を１つ増やす
+/// @param [in] payload allocPayload で確保したブロック
+/// @note 同じブロックを複数の送信先で共有する場合に使う。確保直後の参照数は1。
+void retainPayload(void *payload) noexcept;
+/// @brief 付随データブロックの容量を取得する
+/// @param [in] payload allocPayload で確保したブロック
+/// @return ブロック容量（ブロックでなければ0）
+uint16_t payloadCapacity(void const *payload) noexcept;
+/// @brief 付随データブロックを型として確保する
+/// @tparam T 付随データ型
+/// @retval 0以外 値初期化した付随データ
+/// @retval 0 サイズに合うブロックが残っていない
+template <typename T>
+T *allocPayload() noexcept
+{
+  static_assert(std::is_trivially_destructible<T>::value, "payload must be trivially destructible");
+  void *p = allocPayload(sizeof(T));
+  return p ? new (p) T() : 0;
+}
+} // namespace msg
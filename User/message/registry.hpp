@@ -0,0 +1,176 @@
+/// @file      message/registry.hpp
+/// @author    Hiroshi Mikuriya
+/// @copyright Copyright© 2022 Hiroshi Mikuriya
+///
+/// DO NOT USE THIS SOFTWARE WITHOUT THE SOFTWARE LICENSE AGREEMENT.
+
+#pragma once
+
+#include "msglib.h"
+#include "payload.h"
+#include <type_traits>
+
+namespace msg
+{
+template <ID Type>
+struct Traits;
+template <typename T>
+struct Bind;
+template <typename Handler, ID... Types>
+class Dispatcher;
+/// @brief メッセージ種別をハンドラの引数で区別するための型
+template <ID Type>
+using Tag = std::integral_constant<ID, Type>;
+/// @brief メッセージ種別に対応する付随データ型（付随データなしなら void）
+template <ID Type>
+using PayloadOf = typename Traits<Type>::Payload;
+} // namespace msg
+
+/// @brief メッセージ種別と付随データ型の対応
+/// @tparam Type メッセージ種別
+/// @note 付随データのある種別は msgdef.h で Bind を継承して特殊化する。特殊化しない種別は付随データなし。
+template <msg::ID Type>
+struct msg::Traits
+{
+  using Payload = void; ///< 付随データ型
+};
+
+/// @brief 付随データ型を種別に対応付ける
+/// @tparam T 付随データ型
+/// @note Message::bytes に収まらない型は publish・publishFromIRQ で付随データブロックを使って配信する。
+///       send・sendFromIRQ はブロックを使わないので、収まる型に限る。
+template <typename T>
+struct msg::Bind
+{
+  static_assert(sizeof(T) <= MAX_PAYLOAD_SIZE, "payload must fit in the largest payload block");
+  static_assert(alignof(T) <= alignof(void *), "payload alignment must not exceed Message::bytes alignment");
+  static_assert(std::is_trivially_copyable<T>::value, "payload must be trivially copyable");
+  using Payload = T; ///< 付随データ型
+};
+
+namespace msg
+{
+/// @brief 種別に対応する型で付随データを参照する
+/// @tparam Type メッセージ種別
+/// @param [in] m メッセージ
+/// @retval 0以外 付随データ
+/// @retval 0 種別が一致しない
+template <ID Type>
+PayloadOf<Type> const *as(Message const *m) noexcept
+{
+  return m->type == Type ? static_cast<PayloadOf<Type> const *>(m->data()) : 0;
+}
+/// @brief 種別に対応する型でメッセージ送信
+/// @tparam Type メッセージ種別
+/// @param [in] threadId 送信先スレッドID
+/// @param [in] data 付随データ
+/// @retval osOK 送信成功
+/// @retval それ以外 失敗理由
+template <ID Type>
+osStatus send(osThreadId threadId, PayloadOf<Type> const &data) noexcept
+{
+  static_assert(sizeof(data) <= MAX_MAIL_DATA_SIZE, "send copies the payload into Message::bytes; use publish");
+  return send(threadId, Type, &data, sizeof(data));
+}
+/// @brief 種別に対応する型でメッセージ送信
+/// @tparam Type メッセージ種別
+/// @param [in] mailbox 送信先メールボックス
+/// @param [in] data 付随データ
+/// @retval osOK 送信成功
+/// @retval それ以外 失敗理由
+template <ID Type>
+osStatus send(Mailbox *mailbox, PayloadOf<Type> const &data) noexcept
+{
+  static_assert(sizeof(data) <= MAX_MAIL_DATA_SIZE, "send copies the payload into Message::bytes; use publish");
+  return send(mailbox, Type, &data, sizeof(data));
+}
+/// @brief 種別に対応する型で割り込みからメッセージ送信
+/// @tparam Type メッセージ種別
+/// @param [in] mailbox 送信先メールボックス
+/// @param [in] data 付随データ
+/// @retval osOK 送信成功
+/// @retval それ以外 失敗理由
+template <ID Type>
+osStatus sendFromIRQ(Mailbox *mailbox, PayloadOf<Type> const &data) noexcept
+{
+  static_assert(sizeof(data) <= MAX_MAIL_DATA_SIZE, "sendFromIRQ copies the payload into Message::bytes; use publishFromIRQ");
+  return sendFromIRQ(mailbox, Type, &data, sizeof(data));
+}
+/// @brief 種別に対応する型で購読者全員にメッセージを配信する
+/// @tparam Type メッセージ種別
+/// @param [in] data 付随データ
+/// @retval osOK 全ての購読者に配信した
+/// @retval それ以外 失敗理由
+template <ID Type>
+osStatus publish(PayloadOf<Type> const &data) noexcept
+{
+  return publish(Type, &data, sizeof(data));
+}
+/// @brief 種別に対応する型で割り込みから購読者全員にメッセージを配信する
+/// @tparam Type メッセージ種別
+/// @param [in] data 付随データ
+/// @retval osOK 全ての購読者に配信した
+/// @retval それ以外 失敗理由
+template <ID Type>
+osStatus publishFromIRQ(PayloadOf<Type> const &data) noexcept
+{
+  return publishFromIRQ(Type, &data, sizeof(data));
+}
+} // namespace msg
+
+/// @brief 受信メッセージを種別ごとのハンドラへ振り分ける
+/// @tparam Handler ハンドラ型。Types の各種別について on(Tag<Type>) （付随データなし）
+///                 または on(Tag<Type>, PayloadOf<Type> const &) を持つこと。無ければコンパイルエラーになる。
+/// @tparam Types 振り分けるメッセージ種別
+/// @note 付随データは種別に対応する型の送信関数で送ったものとして、サイズを確認せずに参照する。
+template <typename Handler, msg::ID... Types>
+class msg::Dispatcher
+{
+  Dispatcher() = delete; ///< インスタンス化禁止
+
+  using Thunk = void (*)(Handler &, Message const *); ///< 種別ごとの呼び出し関数型
+  /// @brief 振り分け表の要素
+  struct Entry
+  {
+    ID type;     ///< メッセージ種別
+    Thunk thunk; ///< 呼び出し関数
+  };
+  /// @brief 付随データなしのハンドラを呼び出す
+  template <ID Type>
+  static void call(Handler &h, Message const *, std::true_type)
+  {
+    h.on(Tag<Type>());
+  }
+  /// @brief 付随データありのハンドラを呼び出す
+  template <ID Type>
+  static void call(Handler &h, Message const *m, std::false_type)
+  {
+    h.on(Tag<Type>(), *static_cast<PayloadOf<Type> const *>(m->data()));
+  }
+  /// @brief 種別ごとの呼び出し関数
+  template <ID Type>
+  static void thunk(Handler &h, Message const *m)
+  {
+    call<Type>(h, m, std::is_void<PayloadOf<Type>>());
+  }
+
+public:
+  /// @brief メッセージをハンドラへ振り分ける
+  /// @param [in] h ハンドラ
+  /// @param [in] m メッセージ
+  /// @retval true 振り分けた
+  /// @retval false 振り分け先の無い種別
+  static bool dispatch(Handler &h, Message const *m) noexcept
+  {
+    static constexpr Entry table[] = {{Types, &thunk<Types>}...};
+    for (auto const &e : table)
+    {
+      if (e.type == m->type)
+      {
+        e.thunk(h, m);
+        return true;
+      }
+    }
+    return false;
+  }
+};
@@ -0,0 +1,93 @@
+/// @file      message/ring.hpp
+/// @author    Hiroshi Mikuriya
+/// @copyright Copyright© 2022 Hiroshi Mikuriya
+///
+/// DO NOT USE THIS SOFTWARE WITHOUT THE SOFTWARE LICENSE AGREEMENT.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace msg
+{
+template <typename T>
+class Ring;
+}
+
+/// @brief 1書き込み側・1読み込み側専用のロックフリーリングバッファ
+/// @tparam T 要素型
+/// @note 書き込み側は割り込み、読み込み側はタスクを想定している。
+///       書き込み側は alloc → commit、読み込み側は pop → release の順に呼び出すこと。
+///       release は pop した順に呼び出すこと。
+template <typename T>
+class msg::Ring
+{
+  Ring(Ring const &) = delete;            ///< コピーコンストラクタ削除
+  Ring &operator=(Ring const &) = delete; ///< 代入演算子削除
+
+  T *buf_;                     ///< 要素バッファ
+  uint32_t mask_;              ///< インデックスマスク（要素数 - 1）
+  std::atomic<uint32_t> head_; ///< 書き込み位置（書き込み側のみ更新）
+  std::atomic<uint32_t> read_; ///< 読み込み位置（読み込み側のみ更新）
+  std::atomic<uint32_t> tail_; ///< 解放位置（読み込み側のみ更新）
+
+public:
+  /// @brief コンストラクタ
+  Ring() noexcept : buf_(0), mask_(0), head_(0), read_(0), tail_(0) {}
+  /// @brief デストラクタ
+  virtual ~Ring() {}
+  /// @brief バッファを割り当てる
+  /// @param [in] buf 要素バッファ
+  /// @param [in] size 要素数（2のべき乗であること）
+  void init(T *buf, uint32_t size) noexcept
+  {
+    buf_ = buf;
+    mask_ = size - 1;
+    head_.store(0, std::memory_order_relaxed);
+    read_.store(0, std::memory_order_relaxed);
+    tail_.store(0, std::memory_order_relaxed);
+  }
+  /// @brief バッファ割り当て済みか
+  /// @retval true 割り当て済み
+  /// @retval false 未割り当て
+  bool valid() const noexcept { return buf_ != 0; }
+  /// @brief 書き込み先の要素を取得する（書き込み側）
+  /// @retval 0以外 書き込み先
+  /// @retval 0 満杯
+  T *alloc() noexcept
+  {
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) > mask_)
+    {
+      return 0;
+    }
+    return &buf_[head & mask_];
+  }
+  /// @brief alloc で取得した要素を公開する（書き込み側）
+  /// @retval true 公開前は空だった（読み込み側を起こす必要がある）
+  /// @retval false 公開前から要素があった
+  bool commit() noexcept
+  {
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    bool wasEmpty = head == read_.load(std::memory_order_acquire);
+    head_.store(head + 1, std::memory_order_release);
+    return wasEmpty;
+  }
+  /// @brief 最も古い未読要素を取得する（読み込み側）
+  /// @retval 0以外 要素
+  /// @retval 0 未読要素なし
+  T *pop() noexcept
+  {
+    uint32_t read = read_.load(std::memory_order_relaxed);
+    if (read == head_.load(std::memory_order_acquire))
+    {
+      return 0;
+    }
+    read_.store(read + 1, std::memory_order_release);
+    return &buf_[read & mask_];
+  }
+  /// @brief pop で取得した要素を古い順に解放する（読み込み側）
+  /// @param [in] count 解放する要素数
+  void release(uint32_t count = 1) noexcept { tail_.store(tail_.load(std::memory_order_relaxed) + count, std::memory_order_release); }
+};
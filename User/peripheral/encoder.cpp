@@ -5,72 +5,207 @@
 /// DO NOT USE THIS SOFTWARE WITHOUT THE SOFTWARE LICENSE AGREEMENT.
 
 #include "encoder.h"
+#include "common/alloc.hpp"
+#include "common/cycle_counter.hpp"
+#include "common/interrupt_lock.hpp"
+#include "common/mutex.hpp"
 #include "main.h"
 #include "message/msgdef.h"
-#include "task/resource.h"
+#include "mt_velocity.hpp"
+#include <algorithm>
+#include <atomic>
 #include <initializer_list>
+#include <iterator>
 
 namespace
 {
-msg::EncoderData s_enc{};
+/// 速度を求める区間のサンプル数。制御周期によらず10ms当たりのカウント数で速度を表す。
+constexpr uint32_t VELOCITY_WINDOW = CONTROL_TICK_HZ / 100;
+constexpr float MT_MIN_WINDOW = 0.005f; ///< M/T法の最短計測区間（s）
+constexpr float MT_TIMEOUT = 0.2f;      ///< M/T法で停止とみなすまでの時間（s）
+/// モータID順のノブのエンコーダTIM
+TIM_TypeDef *const ROTARY_TIMS[] = {ENC_NOB1_TIM, ENC_NOB2_TIM};
+/// モータID順のモータのエンコーダTIM
+TIM_TypeDef *const MOTOR_TIMS[] = {ENC_MOTOR1_TIM, ENC_MOTOR2_TIM};
+static_assert(sizeof(ROTARY_TIMS) / sizeof(ROTARY_TIMS[0]) == MOTOR_COUNT, "ROTARY_TIMS must have MOTOR_COUNT entries");
+static_assert(sizeof(MOTOR_TIMS) / sizeof(MOTOR_TIMS[0]) == MOTOR_COUNT, "MOTOR_TIMS must have MOTOR_COUNT entries");
+/// 同時ラッチのトリガを出すTIM（TIM2）。OC3REF をトリガ出力にし、強制出力で立ち上げる
+TIM_TypeDef *const LATCH_MASTER = ENC_MOTOR1_TIM;
+/// 他のエンコーダTIMが LATCH_MASTER のトリガ出力を受ける内部トリガ（TIM1・TIM3・TIM4 の ITR1 が TIM2）
+constexpr uint32_t LATCH_TRIGGER = LL_TIM_TS_ITR1;
+constexpr uint32_t LATCH_WAIT = 16;                 ///< キャプチャ完了を待つ最大ポーリング回数
+msg::EncoderData s_enc{};                           ///< 割り込みで更新するエンコーダ値（割り込みのみ使用）
+std::atomic<uint32_t> s_resetNobs(0);               ///< 次の割り込みでリセットするノブ
+std::atomic<uint32_t> s_resetMotors(0);             ///< 次の割り込みでリセットするモータ
+std::atomic<uint16_t> s_epoch(0);                   ///< 最後に登録したリセットの番号
+int32_t s_diffs[MOTOR_COUNT][VELOCITY_WINDOW] = {}; ///< 速度区間内のモータエンコーダ差分
+uint32_t s_diffIndex = 0;                           ///< 次に書き込む差分の位置
+int16_t s_masterCount = 0;                          ///< LATCH_MASTER のトリガを出した時のカウンタ値
+mik::InterruptLock s_latchLock;                     ///< トリガを出す時刻と LATCH_MASTER を読む時刻を揃える
+/// モータID順のM/T法の速度推定器
+mik::UniquePtr<mik::MTVelocity> s_mt[MOTOR_COUNT];
+
+/// @brief エンコーダTIMを同時ラッチ用に設定する
+void initLatch()
+{
+  for (uint32_t i = 0; i < MOTOR_COUNT; ++i)
+  {
+    for (auto tim : {MOTOR_TIMS[i], ROTARY_TIMS[i]})
+    {
+      if (tim == LATCH_MASTER)
+      {
+        LL_TIM_OC_SetMode(tim, LL_TIM_CHANNEL_CH3, LL_TIM_OCMODE_FORCED_INACTIVE);
+        LL_TIM_SetTriggerOutput(tim, LL_TIM_TRGO_OC3REF);
+        continue;
+      }
+      // 動作中に TS を変えると余計なエッジを検出するので、スレーブモードを一旦止めて変える
+      uint32_t encoderMode = READ_BIT(tim->SMCR, TIM_SMCR_SMS);
+      LL_TIM_SetSlaveMode(tim, LL_TIM_SLAVEMODE_DISABLED);
+      LL_TIM_SetTriggerInput(tim, LATCH_TRIGGER);
+      LL_TIM_SetEncoderMode(tim, encoderMode);
+      LL_TIM_IC_SetActiveInput(tim, LL_TIM_CHANNEL_CH3, LL_TIM_ACTIVEINPUT_TRC);
+      LL_TIM_CC_EnableChannel(tim, LL_TIM_CHANNEL_CH3);
+    }
+  }
+}
+/// @brief 全エンコーダTIMのカウンタをラッチする
+/// @return ラッチした時刻（サイクル数）
+uint32_t latchCounters()
+{
+  for (uint32_t i = 0; i < MOTOR_COUNT; ++i)
+  {
+    for (auto tim : {MOTOR_TIMS[i], ROTARY_TIMS[i]})
+    {
+      if (tim != LATCH_MASTER)
+      {
+        // 前回読まなかったキャプチャ（トリガが遅れた、余計なエッジを拾った）が残っていると、
+        // readCounter が今回のキャプチャを待たずに古い値を返すので、トリガを出す前に消す
+        LL_TIM_ClearFlag_CC3(tim);
+        LL_TIM_ClearFlag_CC3OVR(tim);
+      }
+    }
+  }
+  uint32_t now = 0;
+  {
+    // 高優先度の割り込みで、トリガと LATCH_MASTER の読み込みの間が空かないようにする（数命令）
+    mik::LockGuard<mik::InterruptLock> lock(s_latchLock);
+    now = mik::CycleCounter::now();
+    s_masterCount = static_cast<int16_t>(LL_TIM_GetCounter(LATCH_MASTER));
+    LL_TIM_OC_SetMode(LATCH_MASTER, LL_TIM_CHANNEL_CH3, LL_TIM_OCMODE_FORCED_ACTIVE);
+  }
+  LL_TIM_OC_SetMode(LATCH_MASTER, LL_TIM_CHANNEL_CH3, LL_TIM_OCMODE_FORCED_INACTIVE);
+  return now;
+}
+/// @brief カウンタ値を取得する
+/// @param [in] tim エンコーダTIM
+/// @return 同時ラッチならラッチした値、そうでなければ現在値
+int16_t readCounter(TIM_TypeDef *tim)
+{
+  if (!ENC_SYNC_LATCH)
+  {
+    return static_cast<int16_t>(LL_TIM_GetCounter(tim));
+  }
+  if (tim == LATCH_MASTER)
+  {
+    return s_masterCount;
+  }
+  for (uint32_t n = 0; n < LATCH_WAIT; ++n)
+  {
+    if (LL_TIM_IsActiveFlag_CC3(tim))
+    {
+      return static_cast<int16_t>(LL_TIM_IC_GetCaptureCH3(tim)); // 読むと CC3IF も消える
+    }
+  }
+  return static_cast<int16_t>(LL_TIM_GetCounter(tim)); // トリガが届かなければ現在値で代用する
 }
+/// @brief 登録されたリセット要求を反映する（割り込みから呼び出す）
+/// @param [in] now 現在時刻（サイクル数）
+void applyResets(uint32_t now)
+{
+  uint32_t nobs = s_resetNobs.exchange(0, std::memory_order_acquire);
+  uint32_t motors = s_resetMotors.exchange(0, std::memory_order_acquire);
+  uint16_t epoch = s_epoch.load(std::memory_order_relaxed); // 受け取った要求の番号以上になる
+  for (uint32_t i = 0; i < MOTOR_COUNT; ++i)
+  {
+    if ((nobs | motors) & (1 << i))
+    {
+      s_enc.epoch[i] = epoch;
+    }
+    if (nobs & (1 << i))
+    {
+      s_enc.rotary[i] = 0;
+    }
+    if (motors & (1 << i))
+    {
+      s_enc.motor[i] = 0;
+      s_enc.motorVelocity[i] = 0;
+      std::fill(std::begin(s_diffs[i]), std::end(s_diffs[i]), 0);
+      s_enc.motorSpeed[i] = 0;
+      s_mt[i]->reset(SystemCoreClock, now);
+    }
+  }
+}
+} // namespace
 
 void initEncoder(void)
 {
-  constexpr TIM_TypeDef *tims[] = {ENC_MOTOR1_TIM, ENC_MOTOR2_TIM, ENC_NOB1_TIM, ENC_NOB2_TIM, ENC_UPDATE_TIM};
-  for (auto tim : tims)
+  mik::CycleCounter::enable(); // M/T法でサンプルの時刻に使う
+  for (auto &mt : s_mt)
+  {
+    mt = mik::makeUnique<mik::MTVelocity>(MT_MIN_WINDOW, MT_TIMEOUT);
+    mt->reset(SystemCoreClock, mik::CycleCounter::now());
+  }
+  LL_TIM_SetAutoReload(ENC_UPDATE_TIM, ENC_UPDATE_TIM_CLOCK_HZ / CONTROL_TICK_HZ - 1);
+  for (uint32_t i = 0; i < MOTOR_COUNT; ++i)
   {
-    LL_TIM_SetCounter(tim, 0);
-    LL_TIM_EnableCounter(tim);
+    for (auto tim : {MOTOR_TIMS[i], ROTARY_TIMS[i]})
+    {
+      LL_TIM_SetCounter(tim, 0);
+      LL_TIM_EnableCounter(tim);
+    }
   }
+  if (ENC_SYNC_LATCH)
+  {
+    initLatch();
+  }
+  LL_TIM_SetCounter(ENC_UPDATE_TIM, 0);
+  LL_TIM_EnableCounter(ENC_UPDATE_TIM);
   LL_TIM_EnableIT_UPDATE(ENC_UPDATE_TIM);
 }
 
 void updateEncorderIRQ(void)
 {
-  constexpr TIM_TypeDef *rotaryTim[MOTOR_COUNT] = {ENC_NOB1_TIM, ENC_NOB2_TIM};
-  constexpr TIM_TypeDef *motorTim[MOTOR_COUNT] = {ENC_MOTOR1_TIM, ENC_MOTOR2_TIM};
   static int16_t preRotaryCount[MOTOR_COUNT] = {0};
   static int16_t preMotorCount[MOTOR_COUNT] = {0};
+  uint32_t now = ENC_SYNC_LATCH ? latchCounters() : mik::CycleCounter::now();
+  applyResets(now);
   for (uint32_t i = 0; i < MOTOR_COUNT; ++i)
   {
     {
-      int16_t c = static_cast<int16_t>(LL_TIM_GetCounter(rotaryTim[i]));
+      int16_t c = readCounter(ROTARY_TIMS[i]);
       int32_t d = c - preRotaryCount[i];
       preRotaryCount[i] = c;
       s_enc.rotary[i] += d;
     }
     {
-      int16_t c = static_cast<int16_t>(LL_TIM_GetCounter(motorTim[i]));
+      int16_t c = readCounter(MOTOR_TIMS[i]);
       int32_t d = c - preMotorCount[i];
       preMotorCount[i] = c;
       s_enc.motor[i] += d;
-      s_enc.motorVelocity[i] = d;
+      s_enc.motorVelocity[i] += d - s_diffs[i][s_diffIndex];
+      s_diffs[i][s_diffIndex] = d;
+      s_enc.motorSpeed[i] = s_mt[i]->update(d, now);
     }
   }
-  msg::send(appTaskHandle, msg::ENCODER_DATA_NOTIFY, s_enc);
+  s_diffIndex = (s_diffIndex + 1) % VELOCITY_WINDOW;
+  s_enc.stamp = now;
+  msg::publishFromIRQ<msg::ENCODER_DATA_NOTIFY>(s_enc);
 }
 
-void resetEncoder(uint32_t encoderType)
+uint16_t resetEncoder(uint32_t nobs, uint32_t motors)
 {
-  NVIC_DisableIRQ(ENC_UPDATE_TIM_IRQn);
-  if (encoderType & 1)
-  {
-    s_enc.rotary[0] = 0;
-  }
-  if (encoderType & 2)
-  {
-    s_enc.rotary[1] = 0;
-  }
-  if (encoderType & 4)
-  {
-    s_enc.motor[0] = 0;
-    s_enc.motorVelocity[0] = 0;
-  }
-  if (encoderType & 8)
-  {
-    s_enc.motor[1] = 0;
-    s_enc.motorVelocity[1] = 0;
-  }
-  NVIC_EnableIRQ(ENC_UPDATE_TIM_IRQn);
+  uint16_t epoch = static_cast<uint16_t>(s_epoch.fetch_add(1, std::memory_order_relaxed) + 1);
+  s_resetNobs.fetch_or(nobs, std::memory_order_release);
+  s_resetMotors.fetch_or(motors, std::memory_order_release);
+  return epoch;
 }
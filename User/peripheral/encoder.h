@@ -21,12 +21,13 @@ extern "C"
   void updateEncorderIRQ(void);
 
   /// @brief エンコーダ値をリセットする
-  /// @param [in] encoderType
-  ///   @arg 1 ノブ１
-  ///   @arg 2 ノブ２
-  ///   @arg 4 モータ１
-  ///   @arg 8 モータ２
-  void resetEncoder(uint32_t encoderType);
+  /// @param [in] nobs リセットするノブ（ビット i がモータID i のノブ）
+  /// @param [in] motors リセットするモータ（ビット i がモータID i のモータ）
+  /// @return リセットの番号
+  /// @note 要求を登録するだけで、次のエンコーダ更新タイマ割り込みの先頭で反映する。
+  ///       呼び出す前に配信されて受信側に残っているエンコーダデータ通知は、呼び出した後にもリセット前の値のまま届く。
+  ///       受信側は EncoderData::epoch と戻り値を (int16_t)(epoch - 戻り値) < 0 で比べ、リセット前の値を読み飛ばすこと。
+  uint16_t resetEncoder(uint32_t nobs, uint32_t motors);
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,111 @@
+/// @file      peripheral/mt_velocity.hpp
+/// @author    Hiroshi Mikuriya
+/// @copyright Copyright© 2022 Hiroshi Mikuriya
+///
+/// DO NOT USE THIS SOFTWARE WITHOUT THE SOFTWARE LICENSE AGREEMENT.
+
+#pragma once
+
+#include <cstdint>
+
+namespace mik
+{
+class MTVelocity;
+}
+
+/// @brief M/T法でエンコーダの速度を求めるクラス
+/// @note 一定時間内のカウント数（M法）ではなく、エッジを検出したサンプルから次にエッジを検出したサンプルまでの
+///       カウント数と経過時間の比で速度を求める。計測区間の両端がエッジに揃うので、低速でも 0, ±1, ±2 に量子化されない。
+///       エッジの時刻はサンプル周期の分解能でしか分からないが、両端の誤差は区間が長いほど小さくなる。
+///       エッジが来ない間は「今エッジが来たとした場合の速度」を上限として速度を下げ、一定時間来なければ停止とみなす。
+class mik::MTVelocity
+{
+  MTVelocity() = delete; ///< デフォルトコンストラクタ削除
+
+  float minWindow_;  ///< 最短計測区間（s）
+  float timeout_;    ///< 停止とみなすまでの時間（s）
+  float clockHz_;    ///< 時刻のクロック周波数（Hz）。0なら未開始
+  uint32_t start_;   ///< 計測区間の始まり（エッジを検出したサンプルの時刻）
+  uint32_t edge_;    ///< 最後にエッジを検出したサンプルの時刻
+  int32_t count_;    ///< 計測区間内のカウント数
+  bool synced_;      ///< 計測区間の始まりがエッジに揃っているか（停止後、最初のエッジまでは揃っていない）
+  float velocity_;   ///< 速度（カウント/s）
+
+public:
+  /// @brief コンストラクタ
+  /// @param [in] minWindow 最短計測区間（s）。高速時はこの時間ごとに速度を更新する
+  /// @param [in] timeout 停止とみなすまでの時間（s）。1 / timeout カウント/s 未満の速度は0になる
+  explicit MTVelocity(float minWindow, float timeout) //
+      : minWindow_(minWindow),                        //
+        timeout_(timeout),                            //
+        clockHz_(0),                                  //
+        start_(0),                                    //
+        edge_(0),                                     //
+        count_(0),                                    //
+        synced_(false),                               //
+        velocity_(0)                                  //
+  {
+  }
+  /// @brief デストラクタ
+  virtual ~MTVelocity() {}
+  /// @brief 停止状態から計測を始め直す
+  /// @param [in] clockHz 時刻のクロック周波数（Hz）
+  /// @param [in] now 現在時刻（クロック数）
+  void reset(uint32_t clockHz, uint32_t now)
+  {
+    clockHz_ = static_cast<float>(clockHz);
+    start_ = now;
+    edge_ = now;
+    count_ = 0;
+    synced_ = false;
+    velocity_ = 0;
+  }
+  /// @brief サンプルを１つ加えて速度を更新する
+  /// @param [in] delta 前回のサンプルからのカウント数
+  /// @param [in] now サンプルの時刻（クロック数）。差分は符号なし32bitで計算するので一周しても構わない
+  /// @return 速度（カウント/s）
+  float update(int32_t delta, uint32_t now)
+  {
+    if (clockHz_ == 0)
+    {
+      return 0;
+    }
+    if (delta != 0)
+    {
+      edge_ = now;
+      if (!synced_)
+      {
+        // 停止していた区間は経過時間が分からないので捨て、このエッジから計り始める
+        start_ = now;
+        count_ = 0;
+        synced_ = true;
+        return velocity_;
+      }
+      count_ += delta;
+      float elapsed = (now - start_) / clockHz_;
+      if (minWindow_ <= elapsed)
+      {
+        velocity_ = count_ / elapsed;
+        start_ = now;
+        count_ = 0;
+      }
+      return velocity_;
+    }
+    float idle = (now - edge_) / clockHz_;
+    if (timeout_ <= idle)
+    {
+      start_ = now;
+      edge_ = now;
+      count_ = 0;
+      synced_ = false;
+      velocity_ = 0;
+    }
+    else if (1 < idle * (velocity_ < 0 ? -velocity_ : velocity_))
+    {
+      velocity_ = velocity_ < 0 ? -1 / idle : 1 / idle; // 今の速度ならもうエッジが来ているはずなので、速度を下げる
+    }
+    return velocity_;
+  }
+  /// @brief 速度を取得する @return 速度（カウント/s）
+  float velocity() const { return velocity_; }
+};
@@ -14,19 +14,38 @@ extern "C"
 {
   void appTaskProc(void *argument)
   {
-    msg::registerThread(4);
+    msg::Mailbox *mailbox = 0;
+    msg::registerThread(4, 8, mailbox);
+    msg::registerLatest(mailbox, msg::ENCODER_DATA_NOTIFY); // 処理が遅れても最新のサンプルで制御する
+    msg::registerLatest(mailbox, msg::CURRENT_DATA_NOTIFY);
+    msg::registerUrgent(mailbox, msg::cat::KEY, msg::cat::MASK, 4); // キー操作はセンサデータより先に処理する
+    msg::subscribe(mailbox, msg::cat::KEY, msg::cat::MASK);
+    msg::subscribe(mailbox, msg::cat::PERIPH, msg::cat::MASK);
+    msg::subscribe(mailbox, msg::cat::CTRL, msg::cat::MASK);
     auto app = mik::makeUnique<mik::Application>();
+    msg::Batch batch;
+    if (CONTROL_RATE_HZ)
     {
-      msg::AppPointer d{app.get()};
-      msg::send(i2cOledTaskHandle, msg::APP_POINTER_NOTIFY, d);
+      // タイマ同期制御：制御周期ごとに溜まったコマンドとセンサデータを反映してから制御する
+      osThreadSetPriority(osThreadGetId(), osPriorityRealtime);
+      for (;;)
+      {
+        osSignalWait(SIG_CONTROL_TICK, osWaitForever);
+        msg::recvBatch(mailbox, batch, 0);
+        for (uint32_t i = 0; i < batch.count(); ++i)
+        {
+          app->update(batch.msg(i));
+        }
+        batch.reset();
+        app->control();
+      }
     }
     for (;;)
     {
-      auto res = msg::recv();
-      auto *msg = res.msg();
-      if (msg)
+      msg::recvBatch(mailbox, batch, osWaitForever); // 起床１回で溜まっている分を全て処理する
+      for (uint32_t i = 0; i < batch.count(); ++i)
       {
-        app->update(msg);
+        app->update(batch.msg(i));
       }
     }
   }
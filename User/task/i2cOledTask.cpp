@@ -18,27 +18,32 @@ extern "C"
 {
   void i2cOledTaskProc(void *argument)
   {
-    msg::registerThread(1);
+    msg::Mailbox *mailbox = 0;
+    msg::registerThread(2 * MOTOR_COUNT, 0, mailbox);
+    msg::subscribe(mailbox, msg::MOTOR_STATUS_NOTIFY);
     mik::I2C i2c(I2C1, DMA1, LL_DMA_STREAM_6);
     s_i2c = &i2c;
     mik::SSD1306 oled(&i2c, mik::SSD1306_SLAVE_ADDR0);
     oled.init();
     oled.black();
 
-    mik::Application const *app = 0;
+    msg::MotorStatus status[MOTOR_COUNT] = {};
+    bool received = false;
+    msg::Batch batch;
     for (;;)
     {
-      auto res = msg::recv(100);
-      auto *msg = res.msg();
-      if (msg && msg->type == msg::APP_POINTER_NOTIFY)
+      msg::recvBatch(mailbox, batch, 100); // 全モータ分の状態をまとめて反映してから１回だけ描画する
+      for (uint32_t i = 0; i < batch.count(); ++i)
       {
-        auto data = msg->get<msg::AppPointer>();
-        app = static_cast<mik::Application const *>(data.app);
-      }
-      if (app)
-      {
-        oled.update(app);
+        auto *s = msg::as<msg::MOTOR_STATUS_NOTIFY>(batch.msg(i));
+        if (s && s->motor < MOTOR_COUNT)
+        {
+          status[s->motor] = *s;
+          received = true;
+        }
       }
+      batch.reset();
+      oled.update(received ? status : 0);
     }
   }
 
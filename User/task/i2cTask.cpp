@@ -4,16 +4,19 @@
 ///
 /// DO NOT USE THIS SOFTWARE WITHOUT THE SOFTWARE LICENSE AGREEMENT.
 
+#include "common/alloc.hpp"
 #include "device/ina219.h"
 #include "main.h"
 #include "message/msgdef.h"
 #include "resource.h"
-#include <initializer_list>
 
 namespace
 {
 mik::I2C *s_i2c = 0;
 constexpr int32_t SIG_TIMER = 1;
+/// モータID順の電流センサのスレーブアドレス
+constexpr uint8_t INA219_ADDRS[] = {mik::INA219_SLAVE_ADDR0, mik::INA219_SLAVE_ADDR1};
+static_assert(sizeof(INA219_ADDRS) / sizeof(INA219_ADDRS[0]) == MOTOR_COUNT, "INA219_ADDRS must have MOTOR_COUNT entries");
 } // namespace
 
 extern "C"
@@ -24,28 +27,30 @@ extern "C"
     s_i2c = &i2c;
 
     // ダミー書き込みしないと以降のI2C通信に失敗する
-    for (uint8_t slaveAddr : {mik::INA219_SLAVE_ADDR0, mik::INA219_SLAVE_ADDR1})
+    for (uint8_t slaveAddr : INA219_ADDRS)
     {
       uint8_t u[2] = {0};
       i2c.write(slaveAddr, u, sizeof(u));
     }
 
-    mik::INA219 current0(&i2c, mik::INA219_SLAVE_ADDR0);
-    mik::INA219 current1(&i2c, mik::INA219_SLAVE_ADDR1);
-    current0.init();
-    current1.init();
+    mik::UniquePtr<mik::INA219> sensors[MOTOR_COUNT];
+    for (uint32_t i = 0; i < MOTOR_COUNT; ++i)
+    {
+      sensors[i] = mik::makeUnique<mik::INA219>(&i2c, INA219_ADDRS[i]);
+      sensors[i]->init();
+    }
 
     for (;;)
     {
       osSignalWait(SIG_TIMER, osWaitForever);
       msg::CurrentData cd{};
-      current0.getShuntCurrent(cd.current[0]);
-      current1.getShuntCurrent(cd.current[1]);
-      current0.getBusVoltage(cd.busVoltage[0]);
-      current1.getBusVoltage(cd.busVoltage[1]);
-      // current0.getShuntVoltage(cd.shuntVoltage[0]);
-      // current1.getShuntVoltage(cd.shuntVoltage[1]);
-      msg::send(appTaskHandle, msg::CURRENT_DATA_NOTIFY, cd);
+      for (uint32_t i = 0; i < MOTOR_COUNT; ++i)
+      {
+        sensors[i]->getShuntCurrent(cd.current[i]);
+        sensors[i]->getBusVoltage(cd.busVoltage[i]);
+        // sensors[i]->getShuntVoltage(cd.shuntVoltage[i]);
+      }
+      msg::publish<msg::CURRENT_DATA_NOTIFY>(cd);
     }
   }
 
@@ -78,9 +83,18 @@ extern "C"
     if (LL_TIM_IsActiveFlag_UPDATE(ENC_UPDATE_TIM))
     {
       LL_TIM_ClearFlag_UPDATE(ENC_UPDATE_TIM);
-      osSignalSet(i2cTaskHandle, SIG_TIMER);
+      static uint32_t tick = 0;
+      if (++tick == CONTROL_TICK_HZ / SENSOR_RATE_HZ)
+      {
+        tick = 0;
+        osSignalSet(i2cTaskHandle, SIG_TIMER); // I2C通信は制御周期より遅いので間引く
+      }
       extern void updateEncorderIRQ(void);
       updateEncorderIRQ();
+      if (CONTROL_RATE_HZ)
+      {
+        osSignalSet(appTaskHandle, SIG_CONTROL_TICK); // サンプルを配信した後に起こす
+      }
     }
   }
 }
\ No newline at end of file
@@ -4,20 +4,21 @@
 ///
 /// DO NOT USE THIS SOFTWARE WITHOUT THE SOFTWARE LICENSE AGREEMENT.
 
+#include "control/gpio.hpp"
 #include "main.h"
 #include "message/msgdef.h"
 #include "resource.h"
 
 namespace
 {
-constexpr uint32_t KEY_COUNT = 5;
-constexpr msg::ID KEY_IDS[KEY_COUNT] = {
-    msg::KEY_MOTOR1_LEFT,  //
-    msg::KEY_MOTOR1_RIGHT, //
-    msg::KEY_MOTOR2_LEFT,  //
-    msg::KEY_MOTOR2_RIGHT, //
-    msg::KEY_USR_BTN,      //
+/// モータID順の {左キー, 右キー}
+mik::Gpio const MOTOR_KEYS[][2] = {
+    {{MOTOR1_SWT2_Pin, MOTOR1_SWT1_GPIO_Port}, {MOTOR1_SWT1_Pin, MOTOR1_SWT2_GPIO_Port}}, //
+    {{MOTOR2_SWT2_Pin, MOTOR2_SWT1_GPIO_Port}, {MOTOR2_SWT1_Pin, MOTOR2_SWT2_GPIO_Port}}, //
 };
+static_assert(sizeof(MOTOR_KEYS) / sizeof(MOTOR_KEYS[0]) == MOTOR_COUNT, "MOTOR_KEYS must have MOTOR_COUNT entries");
+constexpr uint32_t KEY_COUNT = 2 * MOTOR_COUNT + 1; ///< モータキー + ユーザボタン
+constexpr uint32_t USR_BTN_INDEX = 2 * MOTOR_COUNT; ///< ユーザボタンの位置
 struct KeyLevels
 {
   bool level[KEY_COUNT];
@@ -25,13 +26,31 @@ struct KeyLevels
 KeyLevels getKeyLevels()
 {
   KeyLevels dst{};
-  dst.level[0] = LL_GPIO_IsInputPinSet(MOTOR1_SWT1_GPIO_Port, MOTOR1_SWT2_Pin) != 0;
-  dst.level[1] = LL_GPIO_IsInputPinSet(MOTOR1_SWT2_GPIO_Port, MOTOR1_SWT1_Pin) != 0;
-  dst.level[2] = LL_GPIO_IsInputPinSet(MOTOR2_SWT1_GPIO_Port, MOTOR2_SWT2_Pin) != 0;
-  dst.level[3] = LL_GPIO_IsInputPinSet(MOTOR2_SWT2_GPIO_Port, MOTOR2_SWT1_Pin) != 0;
-  dst.level[4] = LL_GPIO_IsInputPinSet(USR_BTN_GPIO_Port, USR_BTN_Pin) != 0;
+  for (uint32_t i = 0; i < MOTOR_COUNT; ++i)
+  {
+    dst.level[2 * i] = MOTOR_KEYS[i][0].level();
+    dst.level[2 * i + 1] = MOTOR_KEYS[i][1].level();
+  }
+  dst.level[USR_BTN_INDEX] = LL_GPIO_IsInputPinSet(USR_BTN_GPIO_Port, USR_BTN_Pin) != 0;
   return dst;
 }
+/// @brief キー押下を通知する
+/// @param [in] i キーの位置
+void publishKey(uint32_t i)
+{
+  if (i == USR_BTN_INDEX)
+  {
+    msg::publish(msg::KEY_USR_BTN, 0, 0);
+  }
+  else if (i % 2 == 0)
+  {
+    msg::publish<msg::KEY_MOTOR_LEFT>(msg::KeyData{i / 2});
+  }
+  else
+  {
+    msg::publish<msg::KEY_MOTOR_RIGHT>(msg::KeyData{i / 2});
+  }
+}
 } // namespace
 
 extern "C"
@@ -47,7 +66,7 @@ extern "C"
       {
         if (pre.level[i] && !cur.level[i])
         {
-          msg::send(appTaskHandle, KEY_IDS[i]);
+          publishKey(i);
         }
       }
       pre = cur;
@@ -13,3 +13,6 @@ extern osThreadId keyTaskHandle;
 extern osThreadId i2cTaskHandle;
 extern osThreadId appTaskHandle;
 extern osThreadId i2cOledTaskHandle;
+
+/// タイマ同期制御で appTask に制御周期を知らせるシグナル
+constexpr int32_t SIG_CONTROL_TICK = 1;
@@ -4,48 +4,163 @@
 ///
 /// DO NOT USE THIS SOFTWARE WITHOUT THE SOFTWARE LICENSE AGREEMENT.
 
+#include "common/little_endian.hpp"
 #include "main.h"
 #include "message/msgdef.h"
 #include "resource.h"
 #include "usb_device.h"
 #include "usbd_cdc_if.h"
+#include <atomic>
+#include <cstring>
 
+namespace
+{
 constexpr int32_t SIG_TX_END = 1;
+constexpr uint32_t TX_TIMEOUT = 10;              ///< 前回の送信完了を待つ時間[ms]
+constexpr uint16_t HEAD_SIZE = sizeof(msg::ID); ///< テレメトリ先頭のメッセージ種別のサイズ
+
+/// 送信中のフレーム（付随データが Message::bytes に収まる場合は種別と付随データ、ブロックの場合は種別だけ）
+uint8_t s_frame[HEAD_SIZE + MAX_MAIL_DATA_SIZE];
+/// 送信中の付随データブロック（送信完了割り込みで手放す）
+std::atomic<void *> s_txPayload(0);
+/// 種別に続けて送る付随データブロックのサイズ（0なら続きはない）
+std::atomic<uint16_t> s_txRest(0);
+
+/// @brief 前回の送信が完了するまで待つ
+/// @param [in] millisec タイムアウト時間
+/// @retval true 次の送信を始められる
+/// @retval false 前回の送信が完了していない
+bool waitTxEnd(uint32_t millisec)
+{
+  while (s_txPayload.load() || CDC_IsTransmitting_FS())
+  {
+    if (osSignalWait(SIG_TX_END, millisec).status != osEventSignal)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// @brief メッセージをUSBで送信する
+/// @param [in] msg メッセージ
+/// @note USB_TX_REQ は付随データだけを、購読したテレメトリは受信と同じ形式（先頭2バイトがメッセージ種別）で送る。
+///       付随データブロックはコピーせずに送り、送信完了まで参照を持つ。Message::bytes に収まる付随データは
+///       １パケットに収まるので、メッセージをすぐ解放できるようにフレームへコピーする。
+///       前回の送信が完了しなければ捨てる。
+void transmit(msg::Message const *msg)
+{
+  uint16_t head = msg->type == msg::USB_TX_REQ ? 0 : HEAD_SIZE;
+  if (!waitTxEnd(TX_TIMEOUT))
+  {
+    return;
+  }
+  if (head)
+  {
+    mik::LE<msg::ID>::set(s_frame, msg->type);
+  }
+  if (!msg->payload)
+  {
+    memcpy(s_frame + head, msg->bytes, msg->size);
+    CDC_Transmit_FS(s_frame, static_cast<uint16_t>(head + msg->size));
+    return;
+  }
+  msg::retainPayload(msg->payload);
+  s_txPayload.store(msg->payload);
+  uint8_t res;
+  if (head)
+  {
+    s_txRest.store(msg->size);
+    res = CDC_Transmit_FS(s_frame, head);
+  }
+  else
+  {
+    res = CDC_Transmit_FS(static_cast<uint8_t *>(msg->payload), msg->size);
+  }
+  if (res != USBD_OK)
+  {
+    s_txRest.store(0);
+    msg::freePayload(s_txPayload.exchange(0));
+  }
+}
+
+/// @brief USBから受け付けるメッセージ種別の付随データサイズを取得する
+/// @param [in] type メッセージ種別
+/// @retval 0以上 付随データサイズ
+/// @retval -1 受け付けない種別
+inline int32_t acceptedSize(msg::ID type)
+{
+  switch (type)
+  {
+  case msg::MOTOR_GAINS_REQ:
+    return sizeof(msg::PayloadOf<msg::MOTOR_GAINS_REQ>);
+  case msg::MOTOR_FEEDFORWARD_REQ:
+    return sizeof(msg::PayloadOf<msg::MOTOR_FEEDFORWARD_REQ>);
+  case msg::MOTOR_GEAR_REQ:
+    return sizeof(msg::PayloadOf<msg::MOTOR_GEAR_REQ>);
+  case msg::MOTOR_SYNC_MOVE_REQ:
+    return sizeof(msg::PayloadOf<msg::MOTOR_SYNC_MOVE_REQ>);
+  case msg::MOTOR_COORD_STOP_REQ:
+    return 0;
+  default:
+    return -1;
+  }
+}
+} // namespace
 
 extern "C"
 {
   void usbTaskProc(void *argument)
   {
     MX_USB_DEVICE_Init();
-    msg::registerThread(4);
+    msg::Mailbox *mailbox = 0;
+    msg::registerThread(2 * MOTOR_COUNT + 4, 0, mailbox);
+    msg::subscribe(mailbox, msg::MOTOR_STATUS_NOTIFY); // テレメトリ
     for (;;)
     {
-      auto res = msg::recv();
-      auto *msg = res.msg();
-      if (!msg || msg->type != msg::USB_TX_REQ)
+      auto res = msg::recv(mailbox, osWaitForever);
+      if (res.msg())
       {
-        continue;
+        transmit(res.msg());
       }
-      if (CDC_Transmit_FS(const_cast<uint8_t *>(msg->bytes), msg->size) != USBD_OK)
-      {
-        continue;
-      }
-      osSignalWait(SIG_TX_END, 10);
     }
   }
 
+  /// @brief USB受信割り込み
+  /// @param [in] data 受信データ（先頭2バイトがメッセージ種別（リトルエンディアン）、以降が付随データ）
+  /// @param [in] size 受信データサイズ
+  /// @note 受け付けるのは acceptedSize が返す制御コマンドだけ。付随データサイズが種別と合わなければ捨てる。
   void USB_RxIRQ(uint8_t const *data, uint32_t size)
   {
-    UNUSED(data);
-    UNUSED(size);
-    // do nothing;
+    if (size < sizeof(msg::ID))
+    {
+      return;
+    }
+    msg::ID type = mik::LE<msg::ID>::get(data);
+    uint16_t len = static_cast<uint16_t>(size - sizeof(msg::ID));
+    if (acceptedSize(type) == len)
+    {
+      msg::publishFromIRQ(type, data + sizeof(msg::ID), len);
+    }
   }
 
+  /// @brief USB送信完了割り込み
+  /// @note 種別だけを送った場合は続けて付随データブロックを送り、全て送り終えたらブロックを手放す
   void USB_TxCpltIRQ(uint8_t const *data, uint32_t size, uint8_t ep)
   {
     UNUSED(data);
     UNUSED(size);
     UNUSED(ep);
+    uint16_t rest = s_txRest.exchange(0);
+    if (rest && CDC_Transmit_FS(static_cast<uint8_t *>(s_txPayload.load()), rest) == USBD_OK)
+    {
+      return;
+    }
+    void *payload = s_txPayload.exchange(0);
+    if (payload)
+    {
+      msg::freePayload(payload);
+    }
     osSignalSet(usbTaskHandle, SIG_TX_END);
   }
 }
\ No newline at end of file
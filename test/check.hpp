@@ -0,0 +1,52 @@
+/// @file      check.hpp
+/// @author    Hiroshi Mikuriya
+/// @copyright Copyright© 2022 Hiroshi Mikuriya
+///
+/// DO NOT USE THIS SOFTWARE WITHOUT THE SOFTWARE LICENSE AGREEMENT.
+///
+/// ホストテスト用の最小限の検証マクロ。失敗しても続行し、main の戻り値で結果を返す。
+
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+
+namespace check
+{
+/// @brief 失敗した検証の数
+inline int &failures()
+{
+  static int n = 0;
+  return n;
+}
+/// @brief 検証結果を記録する
+/// @param [in] ok 成否
+/// @param [in] expr 検証した式
+/// @param [in] file ファイル名
+/// @param [in] line 行番号
+inline void record(bool ok, char const *expr, char const *file, int line)
+{
+  if (!ok)
+  {
+    std::printf("%s:%d: FAILED: %s\n", file, line, expr);
+    ++failures();
+  }
+}
+/// @brief テスト結果を表示する
+/// @return main の戻り値
+inline int result()
+{
+  if (failures())
+  {
+    std::printf("%d check(s) failed\n", failures());
+    return 1;
+  }
+  std::printf("all checks passed\n");
+  return 0;
+}
+} // namespace check
+
+/// 式が真であることを検証する
+#define CHECK(expr) check::record((expr), #expr, __FILE__, __LINE__)
+/// a と b の差が tol 以下であることを検証する
+#define CHECK_NEAR(a, b, tol) check::record(std::fabs((a) - (b)) <= (tol), #a " ~ " #b " within " #tol, __FILE__, __LINE__)
@@ -0,0 +1,127 @@
+/// @file      msglib_latest_test.cpp
+/// @author    Hiroshi Mikuriya
+/// @copyright Copyright© 2022 Hiroshi Mikuriya
+///
+/// DO NOT USE THIS SOFTWARE WITHOUT THE SOFTWARE LICENSE AGREEMENT.
+///
+/// Message::bytes に収まらない付随データを上書き型スロットへ配信する。
+/// - 受信側は最新値をブロックのまま受け取る
+/// - 未読のまま上書きされた値・受信し終えた値のブロックは手放され、プールが枯渇しない
+
+#include "check.hpp"
+#include "message/msgdef.h"
+#include "message/payload.h"
+#include "stub/fake_os.h"
+#include <algorithm>
+#include <iterator>
+
+namespace
+{
+constexpr uint16_t SIZE = 200;      ///< 付随データサイズ（256バイトクラス）
+constexpr uint32_t BLOCK_COUNT = 4; ///< 256バイトクラスのブロック数
+
+osThreadId const APP = reinterpret_cast<osThreadId>(1); ///< 受信スレッド
+
+/// @brief 付随データ
+struct Large
+{
+  uint8_t bytes[SIZE]; ///< 値
+};
+
+/// @brief 付随データを作る
+/// @param [in] value 全バイトの値
+/// @return 付随データ
+Large make(uint8_t value)
+{
+  Large d;
+  std::fill(std::begin(d.bytes), std::end(d.bytes), value);
+  return d;
+}
+/// @brief 最新値を受信して確かめる
+/// @param [in] mailbox 受信スレッドのメールボックス
+/// @param [in] value 期待する値
+/// @param [in] skipped 期待する上書き数
+void expect(msg::Mailbox *mailbox, uint8_t value, uint32_t skipped)
+{
+  msg::Result res = msg::recv(mailbox, 0);
+  CHECK(res.msg() && res.msg()->type == msg::ENCODER_DATA_NOTIFY);
+  if (res.msg())
+  {
+    CHECK(res.msg()->size == SIZE && res.msg()->payload != 0);
+    auto const *d = static_cast<Large const *>(res.msg()->data());
+    CHECK(d->bytes[0] == value && d->bytes[SIZE - 1] == value);
+    CHECK(res.skipped() == skipped);
+  }
+}
+/// @brief 256バイトクラスのブロックか
+/// @param [in] p ブロック
+/// @retval true 256バイトクラス
+/// @retval false それ以外、または 0
+bool inClass(void const *p) { return p && msg::payloadCapacity(p) == 256; }
+/// @brief 256バイトクラスのブロックが全て手放されているか
+/// @retval true 全て確保できた
+/// @retval false 手放されていないブロックがある
+bool allReleased()
+{
+  void *blocks[BLOCK_COUNT] = {};
+  bool ok = true;
+  for (auto &b : blocks)
+  {
+    b = msg::allocPayload(SIZE);
+    ok = ok && inClass(b);
+  }
+  for (auto b : blocks)
+  {
+    msg::freePayload(b);
+  }
+  return ok;
+}
+} // namespace
+
+int main()
+{
+  fake::setThread(APP);
+  msg::Mailbox *mailbox = 0;
+  CHECK(msg::registerThread(4, 8, mailbox) == osOK);
+  CHECK(msg::registerLatest(mailbox, msg::ENCODER_DATA_NOTIFY) == osOK);
+  CHECK(msg::subscribe(mailbox, msg::ENCODER_DATA_NOTIFY) == osOK);
+  for (uint8_t i = 1; i <= 50; ++i)
+  {
+    // 割り込みからの配信：３回上書きしても最新値だけを受け取る
+    for (uint8_t k = 0; k < 3; ++k)
+    {
+      Large d = make(i + k);
+      CHECK(msg::publishFromIRQ(msg::ENCODER_DATA_NOTIFY, &d, SIZE) == osOK);
+    }
+    expect(mailbox, i + 2, 2);
+    // タスクからの配信
+    Large d = make(i);
+    CHECK(msg::publish(msg::ENCODER_DATA_NOTIFY, &d, SIZE) == osOK);
+    expect(mailbox, i, 0);
+  }
+  CHECK(allReleased());
+  {
+    // 受信中と未読の値だけがブロックを持つ
+    for (uint8_t k = 0; k < 5; ++k)
+    {
+      Large d = make(k);
+      CHECK(msg::publishFromIRQ(msg::ENCODER_DATA_NOTIFY, &d, SIZE) == osOK);
+    }
+    msg::Result res = msg::recv(mailbox, 0);
+    Large d = make(9);
+    CHECK(msg::publishFromIRQ(msg::ENCODER_DATA_NOTIFY, &d, SIZE) == osOK);
+    void *a = msg::allocPayload(SIZE);
+    void *b = msg::allocPayload(SIZE);
+    void *c = msg::allocPayload(SIZE);
+    CHECK(inClass(a) && inClass(b) && !inClass(c)); // ３つ目は上のサイズクラスから確保される
+    msg::freePayload(a);
+    msg::freePayload(b);
+    msg::freePayload(c);
+  }
+  expect(mailbox, 9, 0);
+  CHECK(allReleased());
+  msg::MailboxStats stats{};
+  CHECK(msg::readStats(mailbox, stats) == osOK);
+  CHECK(stats.dropped == 0);
+  return check::result();
+}
@@ -0,0 +1,75 @@
+/// @file      msglib_lookup_test.cpp
+/// @author    Hiroshi Mikuriya
+/// @copyright Copyright© 2022 Hiroshi Mikuriya
+///
+/// DO NOT USE THIS SOFTWARE WITHOUT THE SOFTWARE LICENSE AGREEMENT.
+///
+/// registerThread が返すメールボックスの検証。
+/// - スレッドIDから検索したメールボックスと一致する
+/// - メールボックス指定でもスレッドID指定でも、そのスレッドにだけ届く
+/// - 未登録のスレッドID、二重登録、登録表の満杯を検出する
+
+#include "check.hpp"
+#include "message/msglib.h"
+#include "stub/fake_os.h"
+#include <cstdint>
+
+namespace
+{
+constexpr uint32_t THREAD_COUNT = 16; ///< 登録するスレッド数（MAX_MAIL_INFO_COUNT）
+constexpr msg::ID TYPE = 0x0101;      ///< 検証に使うメッセージ種別
+
+/// @brief n番目のスレッドID
+osThreadId threadOf(uint32_t n) { return reinterpret_cast<osThreadId>(static_cast<uintptr_t>(0x100 + n)); }
+
+/// @brief 全スレッドのうち、n番目のメールボックスにだけメッセージがあることを確かめて受信する
+/// @param [in] mailboxes スレッド順のメールボックス
+/// @param [in] n メッセージがあるはずのスレッド
+void expectOnly(msg::Mailbox *const (&mailboxes)[THREAD_COUNT], uint32_t n)
+{
+  for (uint32_t i = 0; i < THREAD_COUNT; ++i)
+  {
+    msg::Result res = msg::recv(mailboxes[i], 0);
+    CHECK((res.msg() != 0) == (i == n));
+    CHECK(i != n || (res.msg() && res.msg()->type == TYPE));
+  }
+}
+} // namespace
+
+int main()
+{
+  msg::Mailbox *mailboxes[THREAD_COUNT] = {};
+  for (uint32_t n = 0; n < THREAD_COUNT; ++n)
+  {
+    fake::setThread(threadOf(n));
+    CHECK(msg::registerThread(2, 0, mailboxes[n]) == osOK);
+    CHECK(mailboxes[n] != 0);
+    CHECK(msg::registerThread(2) == osErrorValue); // 同じスレッドは二重に登録できない
+  }
+  for (uint32_t n = 0; n < THREAD_COUNT; ++n)
+  {
+    CHECK(msg::findMailbox(threadOf(n)) == mailboxes[n]);
+    for (uint32_t k = 0; k < n; ++k)
+    {
+      CHECK(mailboxes[k] != mailboxes[n]);
+    }
+  }
+  for (uint32_t n = 0; n < THREAD_COUNT; ++n)
+  {
+    CHECK(msg::send(mailboxes[n], TYPE) == osOK);
+    expectOnly(mailboxes, n);
+    CHECK(msg::send(threadOf(n), TYPE) == osOK);
+    expectOnly(mailboxes, n);
+    fake::setThread(threadOf(n));
+    CHECK(msg::send(mailboxes[n], TYPE) == osOK);
+    msg::Result res = msg::recv(0); // スレッドID指定の受信も同じメールボックスから取り出す
+    CHECK(res.msg() && res.msg()->type == TYPE);
+  }
+  osThreadId const unknown = threadOf(THREAD_COUNT);
+  CHECK(msg::findMailbox(unknown) == 0);
+  CHECK(msg::findMailbox(0) == 0);
+  CHECK(msg::send(unknown, TYPE) == osErrorParameter);
+  fake::setThread(unknown);
+  CHECK(msg::registerThread(2) == osErrorNoMemory); // 登録表が満杯
+  return check::result();
+}
@@ -0,0 +1,154 @@
+/// @file      msglib_priority_test.cpp
+/// @author    Hiroshi Mikuriya
+/// @copyright Copyright© 2022 Hiroshi Mikuriya
+///
+/// DO NOT USE THIS SOFTWARE WITHOUT THE SOFTWARE LICENSE AGREEMENT.
+///
+/// appTask と同じ構成のメールボックスで、メール・リングバッファ・上書き型スロットを全て埋めた状態から
+/// キー押下を処理し終えるまでの最悪遅延を計測する。１メッセージの処理時間は偽のサイクルカウンタで進める。
+
+#include "check.hpp"
+#include "common/cycle_counter.hpp"
+#include "message/latency.h"
+#include "message/msgdef.h"
+#include "stub/fake_os.h"
+
+namespace
+{
+constexpr uint32_t MAIL_COUNT = 4;   ///< メールに格納できる数（appTask と同じ）
+constexpr uint32_t RING_COUNT = 8;   ///< リングバッファに格納できる数（appTask と同じ）
+constexpr uint32_t URGENT_COUNT = 4; ///< 優先メールに格納できる数（appTask と同じ）
+constexpr uint32_t PROCESS_US = 50;  ///< １メッセージの処理時間[μs]
+
+osThreadId const APP = reinterpret_cast<osThreadId>(1); ///< 受信スレッド
+osThreadId const KEY = reinterpret_cast<osThreadId>(2); ///< キー押下を送信するスレッド
+osThreadId const USB = reinterpret_cast<osThreadId>(3); ///< 制御コマンドを送信するスレッド
+
+/// @brief メールボックスの全経路を埋める
+/// @param [in] mailbox 受信スレッドのメールボックス
+void fillBacklog(msg::Mailbox *mailbox)
+{
+  fake::setThread(USB);
+  for (uint32_t i = 0; i < MAIL_COUNT; ++i)
+  {
+    CHECK(msg::send(mailbox, msg::MOTOR_COORD_STOP_REQ) == osOK);
+  }
+  CHECK(msg::send(mailbox, msg::MOTOR_COORD_STOP_REQ) == osEventTimeout); // メールは満杯
+  for (uint32_t i = 0; i < RING_COUNT; ++i)
+  {
+    CHECK(msg::sendFromIRQ(mailbox, msg::MOTOR_COORD_STOP_REQ, 0, 0) == osOK);
+  }
+  CHECK(msg::sendFromIRQ(mailbox, msg::MOTOR_COORD_STOP_REQ, 0, 0) == osEventTimeout); // リングバッファは満杯
+  CHECK(msg::publishFromIRQ<msg::ENCODER_DATA_NOTIFY>(msg::EncoderData{}) == osOK);
+  CHECK(msg::publishFromIRQ<msg::CURRENT_DATA_NOTIFY>(msg::CurrentData{}) == osOK);
+}
+/// @brief キー押下を送信する
+/// @return 送信時刻（サイクル数）
+uint32_t pressKey()
+{
+  fake::setThread(KEY);
+  CHECK(msg::publish<msg::KEY_MOTOR_LEFT>(msg::KeyData{0}) == osOK);
+  fake::setThread(APP);
+  return mik::CycleCounter::now();
+}
+/// @brief 受信したメッセージを処理する
+/// @param [in] batch 受信結果
+/// @param [in] pressed キー押下の送信時刻
+/// @param [out] latency キー押下を処理し終えるまでの時間[μs]（キー押下が無ければ変えない）
+void process(msg::Batch const &batch, uint32_t pressed, uint32_t &latency)
+{
+  for (uint32_t i = 0; i < batch.count(); ++i)
+  {
+    fake::advance(PROCESS_US * fake::cyclesPerMicro());
+    if (batch.msg(i)->type == msg::KEY_MOTOR_LEFT)
+    {
+      latency = mik::CycleCounter::toMicros(mik::CycleCounter::now() - pressed);
+    }
+  }
+}
+/// @brief 全経路が空になるまで受信して処理する
+/// @param [in] mailbox 受信スレッドのメールボックス
+/// @param [in] pressed キー押下の送信時刻
+/// @param [out] latency キー押下を処理し終えるまでの時間[μs]
+void drain(msg::Mailbox *mailbox, uint32_t pressed, uint32_t &latency)
+{
+  msg::Batch batch;
+  while (msg::recvBatch(mailbox, batch, 0) == osOK && 0 < batch.count())
+  {
+    process(batch, pressed, latency);
+  }
+}
+} // namespace
+
+int main()
+{
+  fake::setThread(APP);
+  msg::Mailbox *mailbox = 0;
+  CHECK(msg::registerThread(MAIL_COUNT, RING_COUNT, mailbox) == osOK);
+  CHECK(msg::registerLatest(mailbox, msg::ENCODER_DATA_NOTIFY) == osOK);
+  CHECK(msg::registerLatest(mailbox, msg::CURRENT_DATA_NOTIFY) == osOK);
+  CHECK(msg::registerUrgent(mailbox, msg::cat::KEY, msg::cat::MASK, URGENT_COUNT) == osOK);
+  CHECK(msg::subscribe(mailbox, msg::cat::KEY, msg::cat::MASK) == osOK);
+  CHECK(msg::subscribe(mailbox, msg::cat::PERIPH, msg::cat::MASK) == osOK);
+  uint32_t const backlog = MAIL_COUNT + RING_COUNT + 2;
+
+  {
+    // キー押下が溜まったメッセージより後に届いても、次の起床で最初に取り出す
+    fillBacklog(mailbox);
+    uint32_t pressed = pressKey();
+    msg::MailboxStats stats{};
+    CHECK(msg::readStats(mailbox, stats) == osOK);
+    CHECK(stats.mail.depth == MAIL_COUNT && stats.mail.highWater == MAIL_COUNT);
+    CHECK(stats.ring.depth == RING_COUNT && stats.ring.highWater == RING_COUNT);
+    CHECK(stats.urgent.depth == 1 && stats.urgent.highWater == 1);
+    CHECK(stats.dropped == 2);
+    msg::Batch batch;
+    CHECK(msg::recvBatch(mailbox, batch, 0) == osOK);
+    CHECK(batch.count() == MAX_BATCH_COUNT);
+    CHECK(batch.msg(0)->type == msg::KEY_MOTOR_LEFT);
+    uint32_t latency = 0;
+    process(batch, pressed, latency);
+    batch.reset();
+    drain(mailbox, pressed, latency);
+    std::printf("key after backlog:      %4u us (FIFO would take %u us)\n", static_cast<unsigned>(latency),
+                static_cast<unsigned>((backlog + 1) * PROCESS_US));
+    CHECK(latency <= PROCESS_US);
+  }
+  {
+    // 最悪ケース：まとめて受信した直後にキー押下が届くと、受信済みの分を処理し終えるまで待つ
+    fillBacklog(mailbox);
+    msg::Batch batch;
+    CHECK(msg::recvBatch(mailbox, batch, 0) == osOK);
+    CHECK(batch.count() == MAX_BATCH_COUNT);
+    uint32_t pressed = pressKey();
+    uint32_t latency = 0;
+    process(batch, pressed, latency);
+    CHECK(msg::recvBatch(mailbox, batch, 0) == osOK);
+    CHECK(0 < batch.count() && batch.msg(0)->type == msg::KEY_MOTOR_LEFT);
+    process(batch, pressed, latency);
+    batch.reset();
+    drain(mailbox, pressed, latency);
+    std::printf("key during a batch:     %4u us (bound %u us)\n", static_cast<unsigned>(latency),
+                static_cast<unsigned>((MAX_BATCH_COUNT + 1) * PROCESS_US));
+    CHECK(latency <= (MAX_BATCH_COUNT + 1) * PROCESS_US);
+  }
+  {
+    // recv でも優先メールから取り出し、送信時刻は受信後も残る
+    fillBacklog(mailbox);
+    uint32_t pressed = pressKey();
+    msg::Result res = msg::recv(mailbox, 0);
+    CHECK(res.msg() && res.msg()->type == msg::KEY_MOTOR_LEFT);
+    CHECK(res.msg() && res.msg()->stamp <= pressed && pressed <= res.msg()->received);
+    res.reset();
+    uint32_t latency = 0;
+    drain(mailbox, 0, latency);
+  }
+  msg::MailboxStats stats{};
+  CHECK(msg::readStats(mailbox, stats) == osOK);
+  CHECK(stats.mail.depth == 0 && stats.urgent.depth == 0 && stats.ring.depth == 0);
+  msg::LatencyHistogram hist{};
+  CHECK(msg::readLatency(msg::KEY_MOTOR_LEFT, hist) == osOK);
+  std::printf("max queued key latency: %4u us\n", static_cast<unsigned>(hist.maxQueued));
+  CHECK(hist.maxQueued <= MAX_BATCH_COUNT * PROCESS_US);
+  return check::result();
+}
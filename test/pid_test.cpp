@@ -0,0 +1,98 @@
+/// @file      pid_test.cpp
+/// @author    Hiroshi Mikuriya
+/// @copyright Copyright© 2022 Hiroshi Mikuriya
+///
+/// DO NOT USE THIS SOFTWARE WITHOUT THE SOFTWARE LICENSE AGREEMENT.
+///
+/// mik::PID の検証。
+/// - 拡張機能を設定しなければ、以前の増分形（速度形）PIDと同じ出力になる
+/// - reset 直後に測定値が0でなくても微分項で出力が跳ねない
+/// - 出力制限中に積分項が積み上がらない
+
+#include "check.hpp"
+#include "control/pid.hpp"
+#include <cstdlib>
+
+namespace
+{
+/// @brief 以前の増分形PID（比較用）
+class IncrementalPID
+{
+  float kp_;   ///< 比例項係数
+  float ki_;   ///< 積分項係数
+  float kd_;   ///< 微分項係数
+  float mvn1_; ///< 前回操作量
+  float en1_;  ///< 前回の偏差
+  float en2_;  ///< 前々回の偏差
+  bool first_; ///< 初回の計算か
+
+public:
+  /// @brief コンストラクタ
+  IncrementalPID(float kp, float ki, float kd) : kp_(kp), ki_(ki), kd_(kd), mvn1_(0), en1_(0), en2_(0), first_(true) {}
+  /// @brief 制御値を計算する
+  /// @note 初回は偏差が前から一定だったとみなす（mik::PID の初回と同じ条件）
+  float calc(float target, float fb)
+  {
+    float en = target - fb;
+    if (first_)
+    {
+      first_ = false;
+      en1_ = en2_ = en;
+      mvn1_ = kp_ * en;
+    }
+    // ΔMVn = Kp(en-en-1) + Ki en + Kd((en-en-1) - (en-1-en-2))
+    float dmvn = kp_ * (en - en1_) + ki_ * en + kd_ * ((en - en1_) - (en1_ - en2_));
+    mvn1_ += dmvn;
+    en2_ = en1_;
+    en1_ = en;
+    return mvn1_;
+  }
+};
+/// @brief -1 〜 1 の乱数
+float noise() { return 2.0f * std::rand() / RAND_MAX - 1.0f; }
+} // namespace
+
+int main()
+{
+  {
+    // 拡張機能なしなら増分形と一致する
+    mik::PID pid(0.5f, 0.05f, 0.5f);
+    IncrementalPID ref(0.5f, 0.05f, 0.5f);
+    float fb = 3.0f;
+    float maxDiff = 0;
+    for (int i = 0; i < 1000; ++i)
+    {
+      float target = i < 500 ? 10.0f : -5.0f;
+      float a = pid.calc(target, fb);
+      float b = ref.calc(target, fb);
+      maxDiff = std::fmax(maxDiff, std::fabs(a - b));
+      fb += 0.1f * a + 0.05f * noise();
+    }
+    std::printf("positional vs incremental: max diff %.2g\n", maxDiff);
+    CHECK(maxDiff < 1e-5f);
+  }
+  {
+    // reset 直後に微分項で出力が跳ねない（目標値の重み c = 0 で測定値だけを微分する場合）
+    mik::PID pid(0, 0, 1.0f);
+    pid.setSetpointWeights(1.0f, 0.0f);
+    CHECK_NEAR(pid.calc(0, 5.0f), 0.0f, 1e-6f);
+    CHECK_NEAR(pid.calc(0, 6.0f), -1.0f, 1e-6f); // ２回目からは変化量を微分する
+    pid.reset();
+    CHECK_NEAR(pid.calc(0, 20.0f), 0.0f, 1e-6f);
+  }
+  {
+    // 出力制限中も back-calculation で積分項が制限の外に積み上がらない
+    mik::PID windup(0, 0.1f, 0);
+    mik::PID pid(0, 0.1f, 0);
+    windup.setLimits(-1.0f, 1.0f, 0);
+    pid.setLimits(-1.0f, 1.0f, 1.0f);
+    for (int i = 0; i < 200; ++i)
+    {
+      CHECK_NEAR(pid.calc(1.0f, 0), i < 9 ? 0.1f * (i + 1) : 1.0f, 1e-5f);
+      windup.calc(1.0f, 0);
+    }
+    CHECK(pid.calc(-1.0f, 0) < 1.0f);    // 偏差が反転したらすぐ制限から離れる
+    CHECK(windup.calc(-1.0f, 0) == 1.0f); // アンチワインドアップなしでは積み上がった分が残る
+  }
+  return check::result();
+}
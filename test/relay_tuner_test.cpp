@@ -0,0 +1,107 @@
+/// @file      relay_tuner_test.cpp
+/// @author    Hiroshi Mikuriya
+/// @copyright Copyright© 2022 Hiroshi Mikuriya
+///
+/// DO NOT USE THIS SOFTWARE WITHOUT THE SOFTWARE LICENSE AGREEMENT.
+///
+/// むだ時間のある一次遅れ系（K e^(-Ls) / (τs + 1)）を mik::RelayTuner で測定し、
+/// 限界ゲイン・限界周期を解析解と比べる。
+
+#include "check.hpp"
+#include "control/relay_tuner.hpp"
+#include <cmath>
+#include <cstdio>
+#include <deque>
+
+namespace
+{
+constexpr float DT = 0.001f;      ///< 呼び出し周期（s）
+constexpr float AMPLITUDE = 0.3f; ///< リレー振幅
+constexpr uint32_t CYCLES = 4;    ///< 平均する周期数
+constexpr float TIMEOUT = 10.0f;  ///< 打ち切るまでの時間（s）
+
+/// @brief 制御対象
+struct Plant
+{
+  float k;   ///< ゲイン
+  float tau; ///< 時定数（s）
+  float l;   ///< むだ時間（s）
+};
+
+/// @brief 限界ゲイン・限界周期の解析解を求める
+/// @param [in] p 制御対象
+/// @param [out] ku 限界ゲイン
+/// @param [out] tu 限界周期（s）
+/// @note 位相 -ωL - atan(ωτ) が -π になる ω を二分法で求める
+void ultimate(Plant const &p, double &ku, double &tu)
+{
+  double lo = M_PI / (2 * p.l);
+  double hi = M_PI / p.l;
+  for (int i = 0; i < 100; ++i)
+  {
+    double w = (lo + hi) / 2;
+    (w * p.l + std::atan(w * p.tau) < M_PI ? lo : hi) = w;
+  }
+  ku = std::sqrt(1 + lo * p.tau * lo * p.tau) / p.k;
+  tu = 2 * M_PI / lo;
+}
+
+/// @brief 制御対象を自動調整で測定する
+/// @param [in] p 制御対象
+/// @param [in] hysteresis ヒステリシス
+/// @param [in] target 目標値
+/// @param [out] ku 限界ゲイン
+/// @param [out] tu 限界周期（s）
+/// @retval true 測定完了
+/// @retval false 失敗
+bool measure(Plant const &p, float hysteresis, float target, float &ku, float &tu)
+{
+  mik::RelayTuner tuner(DT, AMPLITUDE, hysteresis, CYCLES, TIMEOUT);
+  std::deque<float> delay(static_cast<size_t>(std::lround(p.l / DT)), 0.0f);
+  float decay = std::exp(-DT / p.tau);
+  float y = 0;
+  while (tuner.state() == mik::RelayTuner::RUNNING)
+  {
+    delay.push_back(tuner.step(target, y));
+    y = decay * y + (1 - decay) * p.k * delay.front();
+    delay.pop_front();
+  }
+  ku = tuner.ultimateGain();
+  tu = tuner.ultimatePeriod();
+  return tuner.state() == mik::RelayTuner::DONE;
+}
+
+/// @brief 測定値が解析解と許容誤差内で一致することを確かめる
+/// @param [in] p 制御対象
+/// @param [in] hysteresis ヒステリシス
+/// @param [in] target 目標値
+/// @param [in] kuTolerance 限界ゲインの許容誤差（比率）
+/// @param [in] tuTolerance 限界周期の許容誤差（比率）
+void verify(Plant const &p, float hysteresis, float target, double kuTolerance, double tuTolerance)
+{
+  double ku0, tu0;
+  ultimate(p, ku0, tu0);
+  float ku = 0, tu = 0;
+  CHECK(measure(p, hysteresis, target, ku, tu));
+  std::printf("K %g tau %g L %g h %g target %g: Ku %.4f (%.4f, %+.1f%%) Tu %.4f (%.4f, %+.1f%%)\n", //
+              p.k, p.tau, p.l, hysteresis, target,                                                //
+              ku, ku0, 100 * (ku / ku0 - 1), tu, tu0, 100 * (tu / tu0 - 1));
+  CHECK(std::fabs(ku / ku0 - 1) <= kuTolerance);
+  CHECK(std::fabs(tu / tu0 - 1) <= tuTolerance);
+}
+} // namespace
+
+int main()
+{
+  Plant const fopdt = {60, 0.05f, 0.02f}; // 解析解は Ku ≈ 0.076、Tu ≈ 0.070s
+  for (float h : {0.01f, 1.5f})
+  {
+    for (float target : {0.0f, 20.0f})
+    {
+      verify(fopdt, h, target, 0.05, 0.10);
+    }
+  }
+  verify({30, 0.05f, 0.03f}, 0.01f, 0, 0.10, 0.10);
+  verify({30, 0.05f, 0.03f}, 1.5f, 20, 0.10, 0.10);
+  return check::result();
+}
@@ -0,0 +1,118 @@
+/// @file      savitzky_golay_test.cpp
+/// @author    Hiroshi Mikuriya
+/// @copyright Copyright© 2022 Hiroshi Mikuriya
+///
+/// DO NOT USE THIS SOFTWARE WITHOUT THE SOFTWARE LICENSE AGREEMENT.
+///
+/// mik::SavitzkyGolay の推定精度を、制御周期（1kHz と 100Hz）でサンプルし１カウント単位に切り捨てたエンコーダ値で確かめる。
+
+#include "check.hpp"
+#include "control/savitzky_golay.hpp"
+#include <cmath>
+#include <cstdio>
+
+namespace
+{
+constexpr uint32_t SIZE = 128;         ///< 履歴のサンプル数（MotorBank::HISTORY_SIZE と同じ）
+constexpr float CLOCK_HZ = 1000000.0f; ///< 時刻のクロック周波数（Hz）
+constexpr uint32_t STEPS = 2000;       ///< サンプル数
+
+/// @brief 誤差の集計
+struct Error
+{
+  float rmsVelocity; ///< 速度の二乗平均平方根誤差（カウント/s）
+  float maxVelocity; ///< 速度の最大誤差（カウント/s）
+  float rmsAccel;    ///< 加速度の二乗平均平方根誤差（カウント/s^2）
+};
+
+/// @brief 等加速度運動を推定した誤差を求める
+/// @tparam Window 推定に使うサンプル数
+/// @param [in] period サンプル間隔（クロック数）
+/// @param [in] v0 初速（カウント/s）
+/// @param [in] accel 加速度（カウント/s^2）
+/// @return 誤差
+template <uint32_t Window>
+Error run(uint32_t period, double v0, double accel)
+{
+  mik::SavitzkyGolay<Window> sg;
+  mik::SampleHistory<1, SIZE> history;
+  Error e = {0, 0, 0};
+  double sumVelocity = 0;
+  double sumAccel = 0;
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < STEPS; ++i)
+  {
+    double t = i * period / CLOCK_HZ;
+    double x = 3.7 + v0 * t + accel * t * t / 2;
+    int32_t const values[1] = {static_cast<int32_t>(std::floor(x))}; // エンコーダは１カウント単位
+    history.push(i * period, values);
+    mik::Motion m;
+    if (!sg.estimate(history, 0, CLOCK_HZ, m))
+    {
+      continue;
+    }
+    // 切り捨ての平均 0.5 カウント分、位置は遅れる。速度・加速度は偏らない
+    double dv = m.velocity - (v0 + accel * t);
+    double da = m.acceleration - accel;
+    e.maxVelocity = std::fmax(e.maxVelocity, static_cast<float>(std::fabs(dv)));
+    sumVelocity += dv * dv;
+    sumAccel += da * da;
+    ++count;
+  }
+  e.rmsVelocity = static_cast<float>(std::sqrt(sumVelocity / count));
+  e.rmsAccel = static_cast<float>(std::sqrt(sumAccel / count));
+  return e;
+}
+/// @brief 許容値
+struct Case
+{
+  double v0;         ///< 初速（カウント/s）
+  double accel;      ///< 加速度（カウント/s^2）
+  float rmsVelocity; ///< 速度の二乗平均平方根誤差の許容値（カウント/s）
+  float maxVelocity; ///< 速度の最大誤差の許容値（カウント/s）
+  float rmsAccel;    ///< 加速度の二乗平均平方根誤差の許容値（カウント/s^2）
+};
+
+/// @brief 制御周期ごとの推定誤差が許容値に収まることを確かめる
+/// @tparam Window 推定に使うサンプル数（MotorBank::ESTIMATE_WINDOW と同じ）
+/// @tparam N 許容値の数
+/// @param [in] rateHz 制御周期（Hz）
+/// @param [in] cases 許容値
+template <uint32_t Window, size_t N>
+void verify(uint32_t rateHz, Case const (&cases)[N])
+{
+  for (auto const &c : cases)
+  {
+    Error e = run<Window>(static_cast<uint32_t>(CLOCK_HZ) / rateHz, c.v0, c.accel);
+    std::printf("%4u Hz v0 %7.1f a %7.1f: velocity error rms %5.2f max %5.2f /s, acceleration error rms %6.1f /s^2\n", //
+                static_cast<unsigned>(rateHz), c.v0, c.accel, e.rmsVelocity, e.maxVelocity, e.rmsAccel);
+    CHECK(e.rmsVelocity <= c.rmsVelocity);
+    CHECK(e.maxVelocity <= c.maxVelocity);
+    CHECK(e.rmsAccel <= c.rmsAccel);
+  }
+}
+} // namespace
+
+int main()
+{
+  // 許容値は実測の1.5〜2倍程度
+  Case const timer[] = {
+      {0, 0, 0.1f, 0.1f, 0.1f}, // 静止
+      {123.4, 0, 2, 5, 30},     // 等速
+      {-250, 0, 2, 5, 30},      //
+      {0, 400, 5, 15, 40},      // 等加速度
+      {-200, 1500, 5, 15, 60},  //
+      {300, -4000, 5, 15, 120}, // 軌道の最大加速度
+  };
+  verify<128>(1000, timer); // タイマ同期制御（CONTROL_RATE_HZ = 1000）
+  Case const message[] = {
+      {0, 0, 0.1f, 0.1f, 0.1f},  // 静止
+      {123.4, 0, 10, 25, 200},   // 等速
+      {-250, 0, 10, 25, 200},    //
+      {0, 400, 20, 40, 300},     // 等加速度
+      {-200, 1500, 20, 40, 300}, //
+      {300, -4000, 20, 40, 300}, // 軌道の最大加速度
+  };
+  verify<12>(100, message); // エンコーダ通知で制御（CONTROL_RATE_HZ = 0）
+  return check::result();
+}
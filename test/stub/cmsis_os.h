@@ -0,0 +1,82 @@
+/// @file      stub/cmsis_os.h
+/// @author    Hiroshi Mikuriya
+/// @copyright Copyright© 2022 Hiroshi Mikuriya
+///
+/// DO NOT USE THIS SOFTWARE WITHOUT THE SOFTWARE LICENSE AGREEMENT.
+///
+/// ホストPCでテストするための CMSIS-RTOS v1 の代用品（msglib が使う分だけ）。
+/// スレッドは切り替えず、fake_os.h で呼び出し元のスレッドIDを差し替えて複数スレッドを模擬する。
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+typedef enum
+{
+  osOK = 0,
+  osEventSignal = 0x08,
+  osEventMessage = 0x10,
+  osEventMail = 0x20,
+  osEventTimeout = 0x40,
+  osErrorParameter = 0x80,
+  osErrorResource = 0x81,
+  osErrorTimeoutResource = 0xC1,
+  osErrorISR = 0x82,
+  osErrorISRRecursive = 0x83,
+  osErrorPriority = 0x84,
+  osErrorNoMemory = 0x85,
+  osErrorValue = 0x86,
+  osErrorOS = 0xFF,
+} osStatus;
+
+typedef void *osThreadId;
+typedef void *osMailQId;
+typedef void *osMutexId;
+typedef void *osSemaphoreId;
+
+struct osMutexDef_t
+{
+  int dummy;
+};
+struct osSemaphoreDef_t
+{
+  int dummy;
+};
+struct osMailQDef_t
+{
+  uint32_t queue_sz;
+  uint32_t item_sz;
+};
+struct osEvent
+{
+  osStatus status;
+  union
+  {
+    uint32_t v;
+    void *p;
+    int32_t signals;
+  } value;
+};
+
+#define osWaitForever 0xFFFFFFFF
+#define osMailQDef(name, queue_sz, type) osMailQDef_t os_mailQ_def_##name = {(queue_sz), sizeof(type)}
+#define osMailQ(name) &os_mailQ_def_##name
+#define osSemaphoreDef(name) osSemaphoreDef_t os_semaphore_def_##name = {0}
+#define osSemaphore(name) &os_semaphore_def_##name
+
+osThreadId osThreadGetId(void);
+osMailQId osMailCreate(osMailQDef_t const *queue_def, osThreadId thread_id);
+void *osMailAlloc(osMailQId queue_id, uint32_t millisec);
+osStatus osMailPut(osMailQId queue_id, void *mail);
+osEvent osMailGet(osMailQId queue_id, uint32_t millisec);
+osStatus osMailFree(osMailQId queue_id, void *mail);
+osMutexId osMutexCreate(osMutexDef_t const *mutex_def);
+osStatus osMutexWait(osMutexId mutex_id, uint32_t millisec);
+osStatus osMutexRelease(osMutexId mutex_id);
+osStatus osMutexDelete(osMutexId mutex_id);
+osSemaphoreId osSemaphoreCreate(osSemaphoreDef_t const *semaphore_def, int32_t count);
+int32_t osSemaphoreWait(osSemaphoreId semaphore_id, uint32_t millisec);
+osStatus osSemaphoreRelease(osSemaphoreId semaphore_id);
+void *pvPortMalloc(size_t size);
+void vPortFree(void *p);
@@ -0,0 +1,113 @@
+/// @file      stub/fake_os.cpp
+/// @author    Hiroshi Mikuriya
+/// @copyright Copyright© 2022 Hiroshi Mikuriya
+///
+/// DO NOT USE THIS SOFTWARE WITHOUT THE SOFTWARE LICENSE AGREEMENT.
+
+#include "fake_os.h"
+#include <cstdlib>
+#include <deque>
+
+DWT_Type g_dwt = {};
+CoreDebug_Type g_coreDebug = {};
+osThreadId g_thread = reinterpret_cast<osThreadId>(1);
+
+namespace
+{
+/// @brief メールキュー
+struct MailQ
+{
+  std::deque<void *> queue; ///< 格納したメール（古い順）
+  uint32_t capacity;        ///< 確保できる最大メール数
+  uint32_t itemSize;        ///< メール１つのサイズ
+  uint32_t allocated;       ///< 確保中のメール数
+};
+/// @brief セマフォ
+struct Semaphore
+{
+  int32_t count; ///< 取得できる数
+  int32_t max;   ///< 最大数
+};
+} // namespace
+
+osThreadId osThreadGetId(void) { return g_thread; }
+
+osMailQId osMailCreate(osMailQDef_t const *queue_def, osThreadId)
+{
+  return new MailQ{{}, queue_def->queue_sz, queue_def->item_sz, 0};
+}
+
+void *osMailAlloc(osMailQId queue_id, uint32_t)
+{
+  auto *q = static_cast<MailQ *>(queue_id);
+  if (q->capacity <= q->allocated)
+  {
+    return 0;
+  }
+  ++q->allocated;
+  return std::calloc(1, q->itemSize);
+}
+
+osStatus osMailPut(osMailQId queue_id, void *mail)
+{
+  static_cast<MailQ *>(queue_id)->queue.push_back(mail);
+  return osOK;
+}
+
+osEvent osMailGet(osMailQId queue_id, uint32_t millisec)
+{
+  auto *q = static_cast<MailQ *>(queue_id);
+  osEvent e = {};
+  if (q->queue.empty())
+  {
+    e.status = millisec ? osEventTimeout : osOK; // スレッドを切り替えないので待たずに戻る
+    return e;
+  }
+  e.status = osEventMail;
+  e.value.p = q->queue.front();
+  q->queue.pop_front();
+  return e;
+}
+
+osStatus osMailFree(osMailQId queue_id, void *mail)
+{
+  --static_cast<MailQ *>(queue_id)->allocated;
+  std::free(mail);
+  return osOK;
+}
+
+osMutexId osMutexCreate(osMutexDef_t const *) { return new int(0); }
+osStatus osMutexWait(osMutexId, uint32_t) { return osOK; }
+osStatus osMutexRelease(osMutexId) { return osOK; }
+osStatus osMutexDelete(osMutexId mutex_id)
+{
+  delete static_cast<int *>(mutex_id);
+  return osOK;
+}
+
+osSemaphoreId osSemaphoreCreate(osSemaphoreDef_t const *, int32_t count) { return new Semaphore{count, count}; }
+
+int32_t osSemaphoreWait(osSemaphoreId semaphore_id, uint32_t)
+{
+  auto *s = static_cast<Semaphore *>(semaphore_id);
+  if (s->count <= 0)
+  {
+    return osErrorOS;
+  }
+  --s->count;
+  return osOK;
+}
+
+osStatus osSemaphoreRelease(osSemaphoreId semaphore_id)
+{
+  auto *s = static_cast<Semaphore *>(semaphore_id);
+  if (s->count < s->max)
+  {
+    ++s->count;
+  }
+  return osOK;
+}
+
+void *pvPortMalloc(size_t size) { return std::calloc(1, size); }
+
+void vPortFree(void *p) { std::free(p); }
@@ -0,0 +1,23 @@
+/// @file      stub/fake_os.h
+/// @author    Hiroshi Mikuriya
+/// @copyright Copyright© 2022 Hiroshi Mikuriya
+///
+/// DO NOT USE THIS SOFTWARE WITHOUT THE SOFTWARE LICENSE AGREEMENT.
+
+#pragma once
+
+#include "main.h"
+
+extern osThreadId g_thread; ///< osThreadGetId が返すスレッドID
+
+namespace fake
+{
+/// @brief 以降の osThreadGetId が返すスレッドIDを変える
+/// @param [in] id スレッドID（0以外）
+inline void setThread(osThreadId id) { g_thread = id; }
+/// @brief サイクルカウンタを進める
+/// @param [in] cycles サイクル数
+inline void advance(uint32_t cycles) { g_dwt.CYCCNT += cycles; }
+/// @brief 1μs当たりのサイクル数 @return サイクル数
+constexpr uint32_t cyclesPerMicro() { return SystemCoreClock / 1000000; }
+} // namespace fake
@@ -0,0 +1,38 @@
+/// @file      stub/main.h
+/// @author    Hiroshi Mikuriya
+/// @copyright Copyright© 2022 Hiroshi Mikuriya
+///
+/// DO NOT USE THIS SOFTWARE WITHOUT THE SOFTWARE LICENSE AGREEMENT.
+///
+/// ホストPCでテストするための main.h の代用品（サイクルカウンタと割り込み禁止だけ）。
+/// DWT->CYCCNT はテストが書き換えて時刻を進める。
+
+#pragma once
+
+#include "cmsis_os.h"
+#include <cstdint>
+
+#define SystemCoreClock 168000000u
+
+/// @brief DWT レジスタの代用品
+struct DWT_Type
+{
+  volatile uint32_t CTRL;   ///< 制御レジスタ
+  volatile uint32_t CYCCNT; ///< サイクルカウンタ
+};
+/// @brief CoreDebug レジスタの代用品
+struct CoreDebug_Type
+{
+  volatile uint32_t DEMCR; ///< 例外・モニタ制御レジスタ
+};
+extern DWT_Type g_dwt;
+extern CoreDebug_Type g_coreDebug;
+
+#define DWT (&g_dwt)
+#define CoreDebug (&g_coreDebug)
+#define DWT_CTRL_CYCCNTENA_Msk 1u
+#define CoreDebug_DEMCR_TRCENA_Msk (1u << 24)
+
+inline uint32_t __get_PRIMASK(void) { return 0; }
+inline void __set_PRIMASK(uint32_t) {}
+inline void __disable_irq(void) {}